@@ -0,0 +1,148 @@
+#include "ChunkBaker.h"
+#include "MeshSprite.h"
+
+ChunkBaker::ChunkBaker(pg::VoronoiMesh<float, TileType> &m,
+                       size_t tWidth, size_t tHeight, size_t threadCount,
+                       ChunkDiskCache *d):
+    mesh(m),
+    texWidth(tWidth),
+    texHeight(tHeight),
+    diskCache(d),
+    stopping(false),
+    requestCount(0),
+    generators(threadCount),
+    workers(threadCount)
+{
+}
+
+ChunkBaker::~ChunkBaker()
+{
+    // Pending tasks return at once, so that joining workers does not wait
+    // for every queued refinement
+    stopping = true;
+}
+
+void ChunkBaker::Request(const std::array<long, 2> &coord)
+{
+    size_t request;
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        request = ++requestCount;
+        requests[coord] = request;
+    }
+
+    workers.Enqueue([this, coord, request]
+    {
+        if(!wanted(coord, request))
+            return;
+
+        std::unique_ptr<BakedChunk> chunk = Acquire();
+        chunk->coord = coord;
+
+        if(diskCache != nullptr && diskCache->Load(coord, chunk->indices))
+        {
+            chunk->step = 1;
+            finish(coord, request);
+            finished.Push(std::move(chunk));
+            return;
+        }
+
+        std::unique_lock<std::shared_timed_mutex> lock(meshMutex);
+        MeshSprite::PrepareArea(mesh, texWidth, texHeight,
+                                coord[0] * float(texWidth),
+                                coord[1] * float(texHeight), generators);
+        lock.unlock();
+
+        bake(std::move(chunk), COARSEST_STEP, request);
+    });
+}
+
+void ChunkBaker::Cancel(const std::array<long, 2> &coord)
+{
+    std::lock_guard<std::mutex> lock(requestMutex);
+    requests.erase(coord);
+}
+
+void ChunkBaker::TakeFinished(std::vector<std::unique_ptr<BakedChunk>> &chunks)
+{
+    finished.TakeAll(chunks);
+}
+
+void ChunkBaker::Recycle(std::unique_ptr<BakedChunk> chunk)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    pool.push_back(std::move(chunk));
+}
+
+std::unique_ptr<BakedChunk> ChunkBaker::Acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if(!pool.empty())
+        {
+            std::unique_ptr<BakedChunk> chunk = std::move(pool.back());
+            pool.pop_back();
+            return chunk;
+        }
+    }
+    return std::unique_ptr<BakedChunk>(new BakedChunk());
+}
+
+bool ChunkBaker::wanted(const std::array<long, 2> &coord, size_t request)
+{
+    if(stopping)
+        return false;
+
+    std::lock_guard<std::mutex> lock(requestMutex);
+    auto it = requests.find(coord);
+    return it != requests.end() && it->second == request;
+}
+
+void ChunkBaker::finish(const std::array<long, 2> &coord, size_t request)
+{
+    std::lock_guard<std::mutex> lock(requestMutex);
+    auto it = requests.find(coord);
+    if(it != requests.end() && it->second == request)
+        requests.erase(it);
+}
+
+void ChunkBaker::bake(std::unique_ptr<BakedChunk> chunk, size_t step,
+                      size_t request)
+{
+    // Cancelled, requested again since, or the baker is being destroyed
+    if(!wanted(chunk->coord, request))
+    {
+        Recycle(std::move(chunk));
+        return;
+    }
+
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(meshMutex);
+        MeshSprite::BakePixels(mesh, chunk->indices, texWidth, texHeight,
+                               chunk->coord[0] * float(texWidth),
+                               chunk->coord[1] * float(texHeight), step,
+                               step == COARSEST_STEP ? 0 : step * 2);
+    }
+    chunk->step = step;
+
+    if(step == 1)
+    {
+        finish(chunk->coord, request);
+        if(diskCache != nullptr)
+            diskCache->Store(chunk->coord, chunk->indices);
+        finished.Push(std::move(chunk));
+        return;
+    }
+
+    // The copy is handed off, the chunk itself keeps being refined
+    std::unique_ptr<BakedChunk> copy = Acquire();
+    *copy = *chunk;
+    finished.Push(std::move(copy));
+
+    // std::function needs a copyable task, hence the raw pointer
+    BakedChunk *refined = chunk.release();
+    workers.Enqueue([this, refined, step, request]
+    {
+        bake(std::unique_ptr<BakedChunk>(refined), step / 2, request);
+    });
+}
@@ -0,0 +1,102 @@
+#ifndef CHUNK_BAKER_H
+#define CHUNK_BAKER_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+#include <SFML/Graphics.hpp>
+
+#include "algorithm/VoronoiMesh.hpp"
+#include "core/ThreadPool.hpp"
+#include "core/HandoffQueue.hpp"
+
+#include "TileType.h"
+#include "ChunkDiskCache.h"
+
+struct BakedChunk
+{
+    std::array<long, 2> coord;
+    size_t step; // One pixel out of step was sampled in each direction
+    std::vector<uint8_t> indices; // Palette index of each pixel
+};
+
+/* Bakes the pixels of texWidth x texHeight chunks of a mesh on worker
+ * threads, so that the render thread only uploads them. Tiles are
+ * generated under an exclusive lock on the mesh, over a pool of their
+ * own, pixels are classified under a shared one. Index buffers go back
+ * to a pool once recycled.
+ *
+ * Chunks are baked progressively, at a step of COARSEST_STEP first, then
+ * refined each time at half the step, reusing the samples of the previous
+ * one, until full resolution. Each refinement is queued behind the
+ * requests already made, so every chunk in view shows up coarse before
+ * any chunk gets refined. Refinements of cancelled chunks are dropped,
+ * as are all pending tasks once the baker is being destroyed. */
+class ChunkBaker
+{
+    public:
+        static const size_t COARSEST_STEP = 8;
+
+        /* mesh must not be used elsewhere while the baker exists. Full
+         * resolution chunks are looked up in diskCache before being baked,
+         * and stored there once baked, if it is not null. */
+        ChunkBaker(pg::VoronoiMesh<float, TileType> &mesh,
+                   size_t texWidth, size_t texHeight,
+                   size_t threadCount = std::thread::hardware_concurrency(),
+                   ChunkDiskCache *diskCache = nullptr);
+        virtual ~ChunkBaker();
+
+        /* Queues the chunk whose top left corner is at coord * tex size.
+         * Requesting it again restarts it from the coarsest step. */
+        void Request(const std::array<long, 2> &coord);
+
+        /* Stops baking the chunk at coord, once its current step is
+         * done. Steps already baked may still arrive. */
+        void Cancel(const std::array<long, 2> &coord);
+
+        /* Appends the chunks baked since the last call, never blocking. A
+         * requested chunk arrives once per step, coarsest first. */
+        void TakeFinished(std::vector<std::unique_ptr<BakedChunk>> &chunks);
+
+        /* Gives back the index buffer of a chunk taken from TakeFinished()
+         * or Acquire() */
+        void Recycle(std::unique_ptr<BakedChunk> chunk);
+
+        /* Returns a recycled chunk, or a new one if there is none */
+        std::unique_ptr<BakedChunk> Acquire();
+
+    protected:
+        void bake(std::unique_ptr<BakedChunk> chunk, size_t step,
+                  size_t request);
+        bool wanted(const std::array<long, 2> &coord, size_t request);
+        void finish(const std::array<long, 2> &coord, size_t request);
+
+        pg::VoronoiMesh<float, TileType> &mesh;
+        size_t texWidth;
+        size_t texHeight;
+        ChunkDiskCache *diskCache;
+        std::shared_timed_mutex meshMutex;
+        std::mutex poolMutex;
+        std::vector<std::unique_ptr<BakedChunk>> pool;
+        pg::HandoffQueue<BakedChunk> finished;
+        std::atomic<bool> stopping;
+
+        // Last request of each chunk being baked, by coord
+        std::mutex requestMutex;
+        size_t requestCount;
+        std::map<std::array<long, 2>, size_t> requests;
+
+        // Used by one worker at a time, under the exclusive lock
+        pg::ThreadPool generators;
+
+        // Last, so that workers are joined before the rest is destroyed
+        pg::ThreadPool workers;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include <cstdio>
+#include <cerrno>
+#include <memory>
+#include <algorithm>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "ChunkDiskCache.h"
+#include "core/Checksum.hpp"
+#include "core/Serializable.hpp"
+#include "core/StreamBackend.hpp"
+#include "core/Varint.hpp"
+
+const uint32_t ChunkDiskCache::MAGIC;
+const uint32_t ChunkDiskCache::VERSION;
+const uint64_t ChunkDiskCache::HEADER_SIZE;
+
+namespace
+{
+    const char EXTENSION[] = ".chunk";
+
+    bool hasSuffix(const std::string &name, const std::string &suffix)
+    {
+        return name.size() >= suffix.size()
+            && name.compare(name.size() - suffix.size(), suffix.size(),
+                            suffix) == 0;
+    }
+}
+
+ChunkDiskCache::ChunkDiskCache(const std::string &d,
+                               const pg::VoronoiMesh<float, TileType> &mesh,
+                               uint64_t generatorHash,
+                               size_t tWidth, size_t tHeight, uint64_t c):
+    directory(d),
+    seed(mesh.Seed()),
+    texWidth(tWidth),
+    texHeight(tHeight),
+    capacity(c),
+    totalSize(0),
+    writer(1)
+{
+    // FNV-1a over the mesh parameters and the generator hash
+    configHash = 0xcbf29ce484222325ULL;
+    uint64_t densityX = mesh.TileDensityX();
+    uint64_t densityY = mesh.TileDensityY();
+    float unitX = mesh.UnitX();
+    float unitY = mesh.UnitY();
+    const std::pair<const void*, size_t> parameters[] = {
+        {&densityX, sizeof(densityX)}, {&densityY, sizeof(densityY)},
+        {&unitX, sizeof(unitX)}, {&unitY, sizeof(unitY)},
+        {&generatorHash, sizeof(generatorHash)}};
+    for(const auto &parameter : parameters)
+    {
+        const unsigned char *bytes =
+            static_cast<const unsigned char*>(parameter.first);
+        for(size_t i = 0; i < parameter.second; ++i)
+            configHash = (configHash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+
+    if(mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+        throw std::runtime_error("Cannot create " + directory);
+    scan();
+}
+
+bool ChunkDiskCache::Load(const std::array<long, 2> &coord,
+                          std::vector<uint8_t> &indices)
+{
+    std::string name = filename(coord);
+    std::string path = directory + "/" + name;
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    uint32_t magic, version, fileSeed, width, height, crc;
+    uint64_t fileConfig, payloadSize;
+    int64_t x, y;
+    std::vector<char> payload;
+    bool good;
+    {
+        pg::FileDescriptorSource source(fd);
+        pg::InputStream stream(source);
+        stream >> magic >> version >> fileSeed >> fileConfig >> width
+               >> height >> x >> y >> payloadSize >> crc;
+
+        // There is at most one run per pixel, of at most 11 bytes
+        good = stream.Good() && magic == MAGIC && version == VERSION
+            && fileSeed == seed && fileConfig == configHash
+            && width == texWidth && height == texHeight
+            && x == coord[0] && y == coord[1]
+            && payloadSize <= uint64_t(texWidth) * texHeight * 11;
+        if(good)
+        {
+            payload.resize(payloadSize);
+            stream.Read(payload.data(), payload.size());
+            good = stream.Good()
+                && pg::Crc32(payload.data(), payload.size()) == crc;
+        }
+    }
+
+    // The modification time tells the order of use after a restart
+    good = good && decode(payload, indices);
+    if(good)
+        futimens(fd, nullptr);
+    close(fd);
+
+    if(good)
+        use(name, 0, false);
+    return good;
+}
+
+void ChunkDiskCache::Store(const std::array<long, 2> &coord,
+                           const std::vector<uint8_t> &indices)
+{
+    std::shared_ptr<std::vector<uint8_t>> copy(
+        new std::vector<uint8_t>(indices));
+    writer.Enqueue([this, coord, copy]
+    {
+        write(coord, *copy);
+    });
+}
+
+void ChunkDiskCache::Flush()
+{
+    writer.Wait();
+}
+
+uint64_t ChunkDiskCache::Size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalSize;
+}
+
+std::string ChunkDiskCache::filename(const std::array<long, 2> &coord) const
+{
+    char name[128];
+    std::snprintf(name, sizeof(name), "%08x_%016llx_%zux%zu_%ld_%ld%s",
+                  seed, static_cast<unsigned long long>(configHash),
+                  texWidth, texHeight, coord[0], coord[1], EXTENSION);
+    return name;
+}
+
+void ChunkDiskCache::scan()
+{
+    DIR *dir = opendir(directory.c_str());
+    if(dir == nullptr)
+        throw std::runtime_error("Cannot read " + directory);
+
+    std::vector<std::pair<struct timespec, std::string>> found;
+    while(struct dirent *entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        std::string path = directory + "/" + name;
+        struct stat info;
+        if(hasSuffix(name, ".tmp")) // Interrupted write
+            std::remove(path.c_str());
+        else if(hasSuffix(name, EXTENSION) && stat(path.c_str(), &info) == 0)
+        {
+            found.push_back({info.st_mtim, name});
+            files[name].size = info.st_size;
+        }
+    }
+    closedir(dir);
+
+    std::sort(found.begin(), found.end(),
+              [](const std::pair<struct timespec, std::string> &a,
+                 const std::pair<struct timespec, std::string> &b)
+    {
+        return a.first.tv_sec < b.first.tv_sec
+            || (a.first.tv_sec == b.first.tv_sec
+                && a.first.tv_nsec < b.first.tv_nsec);
+    });
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for(const auto &file : found)
+    {
+        files[file.second].position = lru.insert(lru.end(), file.second);
+        totalSize += files[file.second].size;
+    }
+    evict();
+}
+
+void ChunkDiskCache::write(const std::array<long, 2> &coord,
+                           const std::vector<uint8_t> &indices)
+{
+    std::vector<char> payload;
+    encode(indices, payload);
+
+    std::string name = filename(coord);
+    std::string path = directory + "/" + name;
+    std::string tmpPath = path + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        return; // The chunk will just be baked again
+
+    bool good;
+    {
+        pg::FileDescriptorSink sink(fd);
+        pg::OutputStream stream(sink);
+        stream << MAGIC << VERSION << uint32_t(seed) << configHash
+               << uint32_t(texWidth) << uint32_t(texHeight)
+               << int64_t(coord[0]) << int64_t(coord[1])
+               << uint64_t(payload.size())
+               << pg::Crc32(payload.data(), payload.size());
+        stream.Write(payload.data(), payload.size());
+        stream.Flush();
+        good = stream.Good();
+    }
+    good &= close(fd) == 0;
+
+    if(!good || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmpPath.c_str());
+        return;
+    }
+
+    use(name, HEADER_SIZE + payload.size(), true);
+}
+
+void ChunkDiskCache::encode(const std::vector<uint8_t> &indices,
+                            std::vector<char> &payload) const
+{
+    // Runs of identical indices: varint length, then the index
+    pg::OutputStream stream(payload);
+    for(size_t i = 0; i < indices.size();)
+    {
+        size_t end = i + 1;
+        while(end < indices.size() && indices[end] == indices[i])
+            ++end;
+
+        pg::WriteVarint(stream, end - i);
+        stream.Write(&indices[i], 1);
+        i = end;
+    }
+}
+
+bool ChunkDiskCache::decode(const std::vector<char> &payload,
+                            std::vector<uint8_t> &indices) const
+{
+    indices.resize(texWidth * texHeight);
+    pg::InputStream stream(payload.data(), payload.size());
+    for(size_t i = 0; i < indices.size();)
+    {
+        uint64_t run = pg::ReadVarint(stream);
+        uint8_t index;
+        stream.Read(&index, 1);
+        if(!stream.Good() || run == 0 || run > indices.size() - i)
+            return false;
+
+        std::fill_n(&indices[i], run, index);
+        i += run;
+    }
+    return true;
+}
+
+void ChunkDiskCache::use(const std::string &name, uint64_t size, bool add)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = files.find(name);
+    if(it != files.end())
+    {
+        lru.erase(it->second.position);
+        if(add)
+        {
+            totalSize -= it->second.size;
+            it->second.size = size;
+            totalSize += size;
+        }
+    }
+    else if(add)
+    {
+        it = files.insert({name, File()}).first;
+        it->second.size = size;
+        totalSize += size;
+    }
+    else // Evicted while being loaded
+        return;
+
+    it->second.position = lru.insert(lru.end(), name);
+    evict();
+}
+
+void ChunkDiskCache::evict()
+{
+    while(totalSize > capacity && !lru.empty())
+    {
+        std::string path = directory + "/" + lru.front();
+        std::remove(path.c_str());
+
+        auto it = files.find(lru.front());
+        totalSize -= it->second.size;
+        files.erase(it);
+        lru.pop_front();
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef CHUNK_DISK_CACHE_H
+#define CHUNK_DISK_CACHE_H
+
+#include <array>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "algorithm/VoronoiMesh.hpp"
+#include "core/ThreadPool.hpp"
+
+#include "TileType.h"
+
+/* Full resolution chunk images kept on disk across runs as palette
+ * indices, one file per chunk. Files are keyed by the seed and parameters
+ * of the mesh, a hash of the property generator configuration, the chunk
+ * size and coordinates, which are all checked again on load along with a
+ * checksum.
+ *
+ * Files are written on a background thread, aside then renamed. Once the
+ * directory holds more than capacity bytes, the least recently used files
+ * are deleted. Loading a file updates its modification time, so that the
+ * order survives restarts. */
+class ChunkDiskCache
+{
+    public:
+        static const uint32_t MAGIC = 0x43434750; // "PGCC"
+        static const uint32_t VERSION = 2;
+        static const uint64_t HEADER_SIZE = 56;
+
+        /* generatorHash must cover everything the tile properties depend
+         * on, the mesh parameters are added to it */
+        ChunkDiskCache(const std::string &directory,
+                       const pg::VoronoiMesh<float, TileType> &mesh,
+                       uint64_t generatorHash,
+                       size_t texWidth, size_t texHeight,
+                       uint64_t capacity = uint64_t(256) << 20);
+        virtual ~ChunkDiskCache() = default;
+
+        /* Fills indices with the palette indices of the chunk at coord
+         * and returns true if it is cached. Can be called from several
+         * threads. */
+        bool Load(const std::array<long, 2> &coord,
+                  std::vector<uint8_t> &indices);
+
+        /* Queues a copy of indices to be written. Can be called from
+         * several threads. */
+        void Store(const std::array<long, 2> &coord,
+                   const std::vector<uint8_t> &indices);
+
+        /* Blocks until every queued chunk is written */
+        void Flush();
+
+        /* Bytes used by the files of the directory */
+        uint64_t Size();
+
+    protected:
+        std::string filename(const std::array<long, 2> &coord) const;
+        void scan();
+        void write(const std::array<long, 2> &coord,
+                   const std::vector<uint8_t> &indices);
+        void encode(const std::vector<uint8_t> &indices,
+                    std::vector<char> &payload) const;
+        bool decode(const std::vector<char> &payload,
+                    std::vector<uint8_t> &indices) const;
+        void use(const std::string &name, uint64_t size, bool add);
+        void evict();
+
+        struct File
+        {
+            std::list<std::string>::iterator position;
+            uint64_t size;
+        };
+
+        std::string directory;
+        unsigned int seed;
+        uint64_t configHash;
+        size_t texWidth;
+        size_t texHeight;
+        uint64_t capacity;
+
+        std::mutex mutex;
+        std::list<std::string> lru; // Least recently used first
+        std::map<std::string, File> files;
+        uint64_t totalSize;
+
+        // Last, so that pending writes end before the rest is destroyed
+        pg::ThreadPool writer;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include <algorithm>
+
+#include "ChunkPyramid.h"
+
+const int ChunkPyramid::MAX_LEVEL;
+
+ChunkKey ChunkKey::Parent() const
+{
+    // Rounds towards negative infinity
+    ChunkKey parent;
+    parent.level = level + 1;
+    for(size_t i = 0; i < 2; ++i)
+        parent.coord[i] = coord[i] >= 0 ? coord[i] / 2 : (coord[i] - 1) / 2;
+    return parent;
+}
+
+ChunkKey ChunkKey::Child(size_t i) const
+{
+    ChunkKey child;
+    child.level = level - 1;
+    child.coord = {{coord[0] * 2 + long(i % 2), coord[1] * 2 + long(i / 2)}};
+    return child;
+}
+
+ChunkPyramid::ChunkPyramid(pg::VoronoiMesh<float, TileType> &mesh,
+                           size_t tWidth, size_t tHeight,
+                           ChunkDiskCache *diskCache, size_t c):
+    texWidth(tWidth),
+    texHeight(tHeight),
+    capacity(c),
+    frame(0),
+    builds(0),
+    baker(mesh, tWidth, tHeight, std::thread::hardware_concurrency(),
+          diskCache)
+{
+}
+
+void ChunkPyramid::Update()
+{
+    ++frame;
+    builds = 0;
+
+    baker.TakeFinished(arrived);
+    for(auto &chunk : arrived)
+    {
+        ChunkKey key = {0, chunk->coord};
+        if(chunk->step == 1)
+            baking.erase(chunk->coord);
+
+        // Refinements may be taken out of order
+        auto it = cache.find(key);
+        if(it != cache.end() && it->second.chunk->step <= chunk->step)
+            baker.Recycle(std::move(chunk));
+        else
+            store(key, std::move(chunk));
+    }
+    arrived.clear();
+
+    cancel();
+    evict();
+}
+
+const BakedChunk *ChunkPyramid::Request(const ChunkKey &key)
+{
+    const BakedChunk *chunk = Find(key);
+    if(key.level == 0 && (chunk == nullptr || chunk->step != 1))
+    {
+        // Also resumes the refinement of a chunk cancelled earlier
+        auto inserted = baking.insert({key.coord, frame});
+        if(inserted.second)
+            baker.Request(key.coord);
+        else
+            inserted.first->second = frame;
+    }
+
+    if(chunk != nullptr || key.level == 0)
+        return chunk;
+
+    // Leaves are baked in parallel, other levels are built one child
+    // after the other
+    const BakedChunk *children[4];
+    bool ready = true;
+    for(size_t i = 0; i < 4; ++i)
+    {
+        children[i] = Request(key.Child(i));
+        if(children[i] == nullptr || children[i]->step != 1)
+        {
+            ready = false;
+            if(key.level > 1)
+                break;
+        }
+    }
+
+    if(!ready || builds == MAX_BUILDS_PER_FRAME)
+        return nullptr;
+    ++builds;
+
+    std::unique_ptr<BakedChunk> parent = baker.Acquire();
+    parent->coord = key.coord;
+    parent->step = 1;
+    downsample(children, *parent);
+    store(key, std::move(parent));
+    return Find(key);
+}
+
+const BakedChunk *ChunkPyramid::Find(const ChunkKey &key)
+{
+    auto it = cache.find(key);
+    if(it == cache.end())
+        return nullptr;
+
+    it->second.lastUse = frame;
+    return it->second.chunk.get();
+}
+
+void ChunkPyramid::store(const ChunkKey &key,
+                         std::unique_ptr<BakedChunk> chunk)
+{
+    Entry &entry = cache[key];
+    if(entry.chunk)
+        baker.Recycle(std::move(entry.chunk));
+    else
+        entry.lastUse = frame;
+    entry.chunk = std::move(chunk);
+}
+
+void ChunkPyramid::cancel()
+{
+    // Same grace period as evict(), so that chunks still in view are kept
+    for(auto it = baking.begin(); it != baking.end();)
+    {
+        if(it->second + 1 < frame)
+        {
+            baker.Cancel(it->first);
+            it = baking.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+void ChunkPyramid::evict()
+{
+    while(cache.size() > capacity)
+    {
+        // Chunks of the previous frame are likely to be requested again
+        auto oldest = cache.end();
+        for(auto it = cache.begin(); it != cache.end(); ++it)
+        {
+            if(it->second.lastUse + 1 < frame && (oldest == cache.end()
+            || it->second.lastUse < oldest->second.lastUse))
+                oldest = it;
+        }
+        if(oldest == cache.end())
+            return;
+
+        baker.Recycle(std::move(oldest->second.chunk));
+        cache.erase(oldest);
+    }
+}
+
+void ChunkPyramid::downsample(const BakedChunk *children[4],
+                              BakedChunk &parent) const
+{
+    // Children are laid out 2 x 2, each parent pixel taking the most
+    // common index of 2 x 2 of their pixels, the top left one on ties,
+    // since palette indices cannot be averaged
+    parent.indices.resize(texWidth * texHeight);
+    for(size_t py = 0; py < texHeight; ++py)
+        for(size_t px = 0; px < texWidth; ++px)
+        {
+            uint8_t samples[4];
+            for(size_t i = 0; i < 4; ++i)
+            {
+                size_t x = px * 2 + i % 2;
+                size_t y = py * 2 + i / 2;
+                const BakedChunk *child =
+                    children[(x >= texWidth) + 2 * (y >= texHeight)];
+                samples[i] = child->indices[x % texWidth
+                                            + y % texHeight * texWidth];
+            }
+
+            size_t best = 0;
+            size_t bestCount = 0;
+            for(size_t i = 0; i < 4; ++i)
+            {
+                size_t count = std::count(samples, samples + 4, samples[i]);
+                if(count > bestCount)
+                {
+                    best = i;
+                    bestCount = count;
+                }
+            }
+            parent.indices[px + py * texWidth] = samples[best];
+        }
+}
@@ -0,0 +1,110 @@
+#ifndef CHUNK_PYRAMID_H
+#define CHUNK_PYRAMID_H
+
+#include <array>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "ChunkBaker.h"
+
+struct ChunkKey
+{
+    int level;
+    std::array<long, 2> coord;
+
+    bool operator<(const ChunkKey &b) const
+    {
+        return level < b.level
+            || (level == b.level && coord < b.coord);
+    }
+
+    bool operator==(const ChunkKey &b) const
+    {
+        return level == b.level && coord == b.coord;
+    }
+
+    ChunkKey Parent() const;
+    ChunkKey Child(size_t i) const;
+};
+
+/* Quadtree of chunk images. A chunk of level L covers 2^L x 2^L chunks of
+ * level 0 with the same texture size, one pixel covering 2^L x 2^L units.
+ * Level 0 chunks are baked by a ChunkBaker, every other level is reduced
+ * from its 4 children the first time it is requested, each pixel taking
+ * the most common palette index of the 4 it covers, so that every level
+ * shows the content of level 0 rather than a resampled mesh. Level 0
+ * chunks not requested during the previous frame stop being refined.
+ *
+ * Chunks are cached, the least recently used ones being evicted once there
+ * are more than capacity. Chunks used during the current frame are never
+ * evicted, so the capacity may be exceeded while building a level: it is
+ * built depth first to keep that overshoot small. */
+class ChunkPyramid
+{
+    public:
+        // A chunk of this level is reduced from 32 x 32 chunks of level
+        // 0, baked once then read back from the disk cache
+        static const int MAX_LEVEL = 5;
+
+        /* mesh must not be used elsewhere while the pyramid exists.
+         * diskCache, if not null, holds level 0 chunks across runs. */
+        ChunkPyramid(pg::VoronoiMesh<float, TileType> &mesh,
+                     size_t texWidth, size_t texHeight,
+                     ChunkDiskCache *diskCache = nullptr,
+                     size_t capacity = 48);
+        virtual ~ChunkPyramid() = default;
+
+        /* Starts a new frame: stores the chunks baked since the previous
+         * one, cancels the ones no longer requested, then evicts chunks
+         * over capacity */
+        void Update();
+
+        /* Returns the chunk if it is cached, nullptr otherwise, in which
+         * case it is baked or built over the next frames as long as it
+         * keeps being requested. A level 0 chunk may not be refined to
+         * full resolution yet. */
+        const BakedChunk *Request(const ChunkKey &key);
+
+        /* Returns the chunk if it is cached, without building it */
+        const BakedChunk *Find(const ChunkKey &key);
+
+        size_t TexWidth() const
+        {
+            return texWidth;
+        }
+
+        size_t TexHeight() const
+        {
+            return texHeight;
+        }
+
+    protected:
+        static const size_t MAX_BUILDS_PER_FRAME = 2;
+
+        struct Entry
+        {
+            std::unique_ptr<BakedChunk> chunk;
+            size_t lastUse;
+        };
+
+        void store(const ChunkKey &key, std::unique_ptr<BakedChunk> chunk);
+        void cancel();
+        void evict();
+        void downsample(const BakedChunk *children[4], BakedChunk &parent)
+            const;
+
+        size_t texWidth;
+        size_t texHeight;
+        size_t capacity;
+        size_t frame;
+        size_t builds;
+        std::map<ChunkKey, Entry> cache;
+        // Frame of the last request of level 0 chunks not at full
+        // resolution yet
+        std::map<std::array<long, 2>, size_t> baking;
+        std::vector<std::unique_ptr<BakedChunk>> arrived;
+        ChunkBaker baker;
+};
+
+#endif
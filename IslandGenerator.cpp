@@ -1,9 +1,13 @@
 #include "IslandGenerator.h"
 
-IslandGenerator::IslandGenerator(float uX, float uY):
+constexpr float IslandGenerator::THRESHOLD;
+
+IslandGenerator::IslandGenerator(float uX, float uY, unsigned int s):
+    rngenerator(pg::CoordSeed<1>(s, {{NOISE_SALT}})),
     noise(rngenerator),
     unitX(uX),
-    unitY(uY)
+    unitY(uY),
+    seed(s)
 {
 }
 
@@ -11,6 +15,37 @@ TileType IslandGenerator::operator()(const pg::VPoint<float> & point)
 {
     float x = point.x * NOISE_DENSITY / unitX;
     float y = point.y * NOISE_DENSITY / unitY;
-    return {noise({x, y}) > .6f};
+
+    float value;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(noiseMutex);
+        if(noise.TryEvaluate({x, y}, value))
+            return {value > THRESHOLD};
+    }
+
+    std::lock_guard<std::shared_timed_mutex> lock(noiseMutex);
+    return {noise({x, y}) > THRESHOLD};
 }
 
+uint64_t IslandGenerator::ConfigHash() const
+{
+    // FNV-1a over the parameters
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto mix = [&hash](const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char*>(data);
+        for(size_t i = 0; i < size; ++i)
+            hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    };
+
+    uint64_t density = NOISE_DENSITY;
+    int32_t salt = NOISE_SALT;
+    float threshold = THRESHOLD;
+    mix(&density, sizeof(density));
+    mix(&salt, sizeof(salt));
+    mix(&threshold, sizeof(threshold));
+    mix(&unitX, sizeof(unitX));
+    mix(&unitY, sizeof(unitY));
+    mix(&seed, sizeof(seed));
+    return hash;
+}
@@ -1,8 +1,12 @@
 #ifndef ISLAND_GENERATOR_H
 #define ISLAND_GENERATOR_H
 
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+
 #include "algorithm/VoronoiUtils.hpp"
-#include "random/StdNumberGenerator.hpp"
+#include "random/SeededNumberGenerator.hpp"
 #include "noise/PerlinNoise2.hpp"
 
 #include "TileType.h"
@@ -10,19 +14,35 @@
 class IslandGenerator : public pg::PropertyGenerator<float, TileType>
 {
     public:
-        IslandGenerator(float unitX, float unitY);
+        /* The same seed always yields the same islands */
+        IslandGenerator(float unitX, float unitY, unsigned int seed);
         virtual ~IslandGenerator() = default;
 
         virtual TileType operator()(const pg::VPoint<float> & point);
 
+        /* Concurrent calls share the noise nodes generated so far, and
+         * only wait for each other to generate missing ones */
+        virtual bool ThreadSafe() const
+        {
+            return true;
+        }
+
+        /* Hash of everything the islands depend on, seed included */
+        uint64_t ConfigHash() const;
+
     protected:
         static const size_t NOISE_DENSITY = 8;
+        // Mixed into the seed of the noise, so that it does not draw the
+        // same numbers as a mesh seeded with the same seed
+        static const int NOISE_SALT = 1;
+        static constexpr float THRESHOLD = .6f;
 
-        pg::StdNumberGenerator rngenerator;
+        pg::SeededNumberGenerator rngenerator;
         pg::PerlinNoiseUniformFloat<2> noise;
+        std::shared_timed_mutex noiseMutex;
         float unitX;
         float unitY;
+        unsigned int seed;
 };
 
 #endif
-
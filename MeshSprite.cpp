@@ -1,48 +1,80 @@
+#include <array>
+#include <algorithm>
 #include <stdexcept>
 
 #include "MeshSprite.h"
+#include "algorithm/MeshRenderer.hpp"
+#include "TileColors.h"
 
-MeshSprite::MeshSprite(pg::VoronoiMesh<float, TileType> &mesh,
-                       size_t texWidth, size_t texHeight,
-                       float offsetX, float offsetY)
+MeshSprite::MeshSprite(size_t tWidth, size_t tHeight):
+    texWidth(tWidth),
+    texHeight(tHeight)
 {
-    sf::Uint8 *pixels = new sf::Uint8[texWidth * texHeight * 4];
+    if(!texture.create(texWidth, texHeight))
+        throw std::runtime_error("Cannot create texture");
+
+    setTexture(texture);
+}
 
-    for(size_t y = 0; y < texHeight; ++y)
-        for(size_t x = 0; x < texWidth; ++x)
+void MeshSprite::Upload(const std::vector<uint8_t> &bakedIndices,
+                        float offsetX, float offsetY)
+{
+    // Uploads all run on the GL thread, so sprites share one RGBA buffer
+    static std::vector<sf::Uint8> pixels;
+    static const std::array<std::array<sf::Uint8, 4>, 256> lut = []
+    {
+        std::array<std::array<sf::Uint8, 4>, 256> colors;
+        for(size_t i = 0; i < colors.size(); ++i)
+            IndexColor(i, colors[i].data());
+        return colors;
+    }();
+
+    pixels.resize(bakedIndices.size() * 4);
+    for(size_t i = 0; i < bakedIndices.size(); ++i)
+        std::copy(lut[bakedIndices[i]].begin(), lut[bakedIndices[i]].end(),
+                  &pixels[i * 4]);
+
+    texture.update(pixels.data());
+    setPosition(offsetX, offsetY);
+}
+
+void MeshSprite::PrepareArea(pg::VoronoiMesh<float, TileType> &mesh,
+                             size_t tWidth, size_t tHeight,
+                             float offsetX, float offsetY,
+                             pg::ThreadPool &pool)
+{
+    pg::PrepareMeshArea(mesh, offsetX, offsetY, tWidth, tHeight, pool);
+}
+
+void MeshSprite::BakePixels(const pg::VoronoiMesh<float, TileType> &mesh,
+                            std::vector<uint8_t> &indices,
+                            size_t tWidth, size_t tHeight,
+                            float offsetX, float offsetY,
+                            size_t step, size_t coarserStep)
+{
+    indices.resize(tWidth * tHeight);
+    for(size_t y = 0; y < tHeight; y += step)
+        for(size_t x = 0; x < tWidth; x += step)
         {
+            if(coarserStep != 0 && x % coarserStep == 0
+            && y % coarserStep == 0)
+                continue;
+
             pg::VPoint<float> vpoint;
             vpoint.x = x + offsetX;
             vpoint.y = y + offsetY;
 
-            TileType isIsland = mesh.SiteAt(vpoint).properties;
-            size_t i = (x + y * texWidth) * 4;
-
-            if(isIsland.island)
-            {
-                pixels[i  ] = 192;
-                pixels[i+1] = 192;
-                pixels[i+2] = 64;
-            }
-            else
-            {
-                pixels[i  ] = 64;
-                pixels[i+1] = 64;
-                pixels[i+2] = 255;
-            }
-
-            pixels[i+3] = 0xff;
-        }
-    
-    sf::Image image;
-    image.create(texWidth, texHeight, pixels);
+            const pg::VoronoiSite<float, TileType> *site =
+                mesh.FindSiteAt(vpoint);
+            if(site == nullptr)
+                throw std::logic_error("MeshSprite area was not prepared");
 
-    if(!texture.create(texWidth, texHeight))
-        throw std::runtime_error("Cannot create texture");
-    if(!texture.loadFromImage(image))
-        throw std::runtime_error("Cannot load texture");
-    delete [] pixels;
-   
-    setTexture(texture);
+            // Fills the whole block with the sample
+            uint8_t index = TileIndex(site->properties);
+            size_t blockWidth = std::min(step, tWidth - x);
+            size_t blockHeight = std::min(step, tHeight - y);
+            for(size_t by = 0; by < blockHeight; ++by)
+                std::fill_n(&indices[x + (y + by) * tWidth], blockWidth,
+                            index);
+        }
 }
-
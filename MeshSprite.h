@@ -1,23 +1,53 @@
 #ifndef MESH_SPRITE_H
 #define MESH_SPRITE_H
 
+#include <vector>
+#include <cstdint>
+
 #include <SFML/Graphics.hpp>
 
 #include "algorithm/VoronoiMesh.hpp"
+#include "core/ThreadPool.hpp"
 
 #include "TileType.h"
 
 class MeshSprite : public sf::Sprite
 {
     public:
-        MeshSprite(pg::VoronoiMesh<float, TileType> &mesh,
-                   size_t texWidth, size_t texHeight,
-                   float offsetX, float offsetY);
+        MeshSprite(size_t texWidth, size_t texHeight);
         virtual ~MeshSprite() = default;
 
+        /* Uploads palette indices baked by BakePixels(), expanded to RGBA
+         * through a lookup table, and moves the sprite to their offset.
+         * Must run on the thread owning the GL context. */
+        void Upload(const std::vector<uint8_t> &indices,
+                    float offsetX, float offsetY);
+
+        /* Generates the tiles of mesh that BakePixels() reads for an area,
+         * split over pool */
+        static void PrepareArea(pg::VoronoiMesh<float, TileType> &mesh,
+                                size_t texWidth, size_t texHeight,
+                                float offsetX, float offsetY,
+                                pg::ThreadPool &pool);
+
+        /* Fills indices with the palette index of each pixel of an area
+         * prepared by PrepareArea(), one byte per pixel. Only reads mesh,
+         * so it can run on several threads at once. With a step above 1,
+         * only one pixel out of step is sampled in each direction and
+         * fills a step x step block. If coarserStep is not 0, indices
+         * already hold the image baked at that step, a multiple of step,
+         * and its samples are kept: baking at 8, 4, 2 then 1 samples each
+         * pixel once in total. */
+        static void BakePixels(const pg::VoronoiMesh<float, TileType> &mesh,
+                               std::vector<uint8_t> &indices,
+                               size_t texWidth, size_t texHeight,
+                               float offsetX, float offsetY,
+                               size_t step = 1, size_t coarserStep = 0);
+
     protected:
+        size_t texWidth;
+        size_t texHeight;
         sf::Texture texture;
 };
 
 #endif
-
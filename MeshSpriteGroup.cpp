@@ -1,38 +1,140 @@
+#include <cmath>
+#include <algorithm>
+
 #include "MeshSpriteGroup.h"
 
+constexpr float MeshSpriteGroup::MIN_ZOOM;
+constexpr float MeshSpriteGroup::MAX_ZOOM;
+
 MeshSpriteGroup::MeshSpriteGroup(pg::VoronoiMesh<float, TileType> &mesh,
-                                 size_t tWidth, size_t tHeight):
+                                 size_t tWidth, size_t tHeight,
+                                 ChunkDiskCache *diskCache):
     texWidth(tWidth),
     texHeight(tHeight),
-    view(sf::Vector2f(tWidth, tHeight), sf::Vector2f(tWidth, tHeight))
+    zoom(1),
+    view(sf::Vector2f(tWidth, tHeight), sf::Vector2f(tWidth, tHeight)),
+    pyramid(mesh, tWidth, tHeight, diskCache),
+    viewStep(0)
 {
-    for(size_t y = 0; y < SPRITE_DIM; ++y)
-        for(size_t x = 0; x < SPRITE_DIM; ++x)
-        {
-            MeshSprite *sprite =
-                new MeshSprite(mesh, texWidth, texHeight,
-                               x * texWidth, y * texHeight);
-            sprite->setPosition(x * texWidth, y * texHeight);
-            sprites[x + y * SPRITE_DIM].reset(sprite);
-        }
+    for(size_t i = 0; i < SPRITE_COUNT; ++i)
+    {
+        sprites[i].reset(new MeshSprite(texWidth, texHeight));
+        shownSteps[i] = 0;
+        drawn[i] = false;
+    }
+
+    Refresh();
 }
 
 MeshSpriteGroup::~MeshSpriteGroup()
 {
 }
 
+void MeshSpriteGroup::SetZoom(float z)
+{
+    zoom = std::min(std::max(z, MIN_ZOOM), MAX_ZOOM);
+}
+
 void MeshSpriteGroup::Refresh()
 {
+    pyramid.Update();
+
     sf::Vector2f center = getTransform().transformPoint(texWidth*1.5f,
                                                         texHeight*1.5f);
+    sf::Vector2f size(texWidth * zoom, texHeight * zoom);
     view.setCenter(center);
+    view.setSize(size);
+
+    // The view spans less than 2 chunks of that level
+    int level = zoom < 1 ? 0 : std::floor(std::log2(zoom));
+    level = std::min(level, ChunkPyramid::MAX_LEVEL);
+    float chunkWidth = std::ldexp(float(texWidth), level);
+    float chunkHeight = std::ldexp(float(texHeight), level);
+
+    long minX = std::floor((center.x - size.x / 2) / chunkWidth);
+    long minY = std::floor((center.y - size.y / 2) / chunkHeight);
+    long maxX = std::floor((center.x + size.x / 2) / chunkWidth);
+    long maxY = std::floor((center.y + size.y / 2) / chunkHeight);
+    // Rounding errors at the largest zoom of a level must not add chunks
+    maxX = std::min(maxX, minX + long(SPRITE_DIM) - 1);
+    maxY = std::min(maxY, minY + long(SPRITE_DIM) - 1);
+
+    inView.clear();
+    viewStep = 1;
+    for(long y = minY; y <= maxY; ++y)
+        for(long x = minX; x <= maxX; ++x)
+        {
+            ChunkKey key = {level, {{x, y}}};
+            const BakedChunk *chunk = pyramid.Request(key);
+            if(chunk != nullptr)
+                viewStep = viewStep == 0 ? 0 : std::max(viewStep, chunk->step);
+            else
+            {
+                viewStep = 0;
+                while(chunk == nullptr && key.level < ChunkPyramid::MAX_LEVEL)
+                {
+                    key = key.Parent();
+                    chunk = pyramid.Find(key);
+                }
+                if(chunk == nullptr)
+                    continue;
+            }
+
+            if(std::find(inView.begin(), inView.end(), key) == inView.end())
+                inView.push_back(key);
+        }
+
+    for(size_t i = 0; i < SPRITE_COUNT; ++i)
+    {
+        drawn[i] = drawn[i] && std::find(inView.begin(), inView.end(),
+                                         shown[i]) != inView.end();
+    }
+    for(const ChunkKey &key : inView)
+        show(key);
+}
+
+size_t MeshSpriteGroup::Step() const
+{
+    return viewStep;
 }
 
 void MeshSpriteGroup::draw(sf::RenderTarget &target, sf::RenderStates states)
             const
 {
+    // Coarser ancestors first, so that finer chunks are drawn over them
     target.setView(view);
-    for(size_t i = 0; i < SPRITE_COUNT; ++i)
-        target.draw(*(sprites[i]), states);
+    for(int level = ChunkPyramid::MAX_LEVEL; level >= 0; --level)
+        for(size_t i = 0; i < SPRITE_COUNT; ++i)
+        {
+            if(drawn[i] && shown[i].level == level)
+                target.draw(*(sprites[i]), states);
+        }
 }
 
+void MeshSpriteGroup::show(const ChunkKey &key)
+{
+    size_t i = 0;
+    while(i < SPRITE_COUNT && !(drawn[i] && shown[i] == key))
+        ++i;
+
+    if(i == SPRITE_COUNT)
+    {
+        // At most SPRITE_COUNT chunks are in view, one sprite is free
+        i = 0;
+        while(drawn[i])
+            ++i;
+        shown[i] = key;
+        shownSteps[i] = 0;
+        drawn[i] = true;
+    }
+
+    const BakedChunk *chunk = pyramid.Find(key);
+    if(chunk->step == shownSteps[i])
+        return;
+
+    float scale = std::ldexp(1.f, key.level);
+    sprites[i]->Upload(chunk->indices, key.coord[0] * scale * texWidth,
+                       key.coord[1] * scale * texHeight);
+    sprites[i]->setScale(scale, scale);
+    shownSteps[i] = chunk->step;
+}
@@ -2,33 +2,67 @@
 #define MESH_SPRITE_GROUP_H
 
 #include <memory>
+#include <vector>
 
 #include <SFML/Graphics.hpp>
 
 #include "MeshSprite.h"
+#include "ChunkPyramid.h"
 
+/* Draws the chunks of a ChunkPyramid around the view, whose size is one
+ * chunk of level 0 times the zoom. The level is picked from the zoom so
+ * that at most 3 x 3 chunks cover the view, whatever the zoom, and frame
+ * costs stay the same from the closest to the farthest view. Chunks not
+ * available yet are replaced by their closest cached ancestor. A sprite is
+ * only uploaded when its chunk shows up or gets refined. */
 class MeshSpriteGroup : public sf::Drawable, public sf::Transformable
 {
     public:
+        static constexpr float MIN_ZOOM = 1.f / 8.f;
+        static constexpr float MAX_ZOOM = 1 << (ChunkPyramid::MAX_LEVEL + 1);
+
         MeshSpriteGroup(pg::VoronoiMesh<float, TileType> &mesh,
-                        size_t texWidth, size_t texHeight);
+                        size_t texWidth, size_t texHeight,
+                        ChunkDiskCache *diskCache = nullptr);
         virtual ~MeshSpriteGroup();
 
+        /* Sets the number of units per pixel of the view, clamped to
+         * [MIN_ZOOM, MAX_ZOOM] */
+        void SetZoom(float zoom);
+
+        float Zoom() const
+        {
+            return zoom;
+        }
+
+        /* Centers the view on the transform, requests the chunks in view
+         * and uploads the ones that changed since the last call */
         void Refresh();
 
+        /* Coarsest sampling step among the chunks in view, 1 once they
+         * are all at full resolution, 0 while one of them is missing */
+        size_t Step() const;
+
         virtual void draw(sf::RenderTarget &target, sf::RenderStates states)
             const;
 
     protected:
         static const size_t SPRITE_DIM = 3;
         static const size_t SPRITE_COUNT = SPRITE_DIM * SPRITE_DIM;
-        static const size_t NOISE_DETAIL = 8;
+
+        void show(const ChunkKey &key);
 
         size_t texWidth;
         size_t texHeight;
+        float zoom;
         sf::View view;
+        ChunkPyramid pyramid;
         std::unique_ptr<MeshSprite> sprites[SPRITE_COUNT];
+        ChunkKey shown[SPRITE_COUNT];
+        size_t shownSteps[SPRITE_COUNT]; // 0 until uploaded
+        bool drawn[SPRITE_COUNT];
+        std::vector<ChunkKey> inView;
+        size_t viewStep;
 };
 
 #endif
-
@@ -0,0 +1,53 @@
+#ifndef TILE_COLORS_H
+#define TILE_COLORS_H
+
+#include <cstdint>
+
+#include "TileType.h"
+
+/* Palette index of a tile, which is what baked chunks store per pixel */
+inline uint8_t TileIndex(const TileType &tile)
+{
+    return tile.island ? 1 : 0;
+}
+
+/* RGBA color of a palette index */
+inline void IndexColor(uint8_t index, uint8_t *rgba)
+{
+    if(index == 1) // Island
+    {
+        rgba[0] = 192;
+        rgba[1] = 192;
+        rgba[2] = 64;
+    }
+    else
+    {
+        rgba[0] = 64;
+        rgba[1] = 64;
+        rgba[2] = 255;
+    }
+
+    rgba[3] = 0xff;
+}
+
+/* RGBA color of a tile, shared by the window and headless renderers */
+inline void TileColor(const TileType &tile, uint8_t *rgba)
+{
+    IndexColor(TileIndex(tile), rgba);
+}
+
+/* Lightens the water color rgba up to depth away from the coast, for
+ * shallow water */
+inline void ShallowColor(float distance, float depth, uint8_t *rgba)
+{
+    const uint8_t SHALLOW[3] = {96, 192, 255};
+
+    if(!(distance > 0) || !(distance < depth))
+        return;
+
+    float t = 1 - distance / depth;
+    for(size_t i = 0; i < 3; ++i)
+        rgba[i] += (SHALLOW[i] - rgba[i]) * t;
+}
+
+#endif
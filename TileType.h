@@ -2,8 +2,9 @@
 #define TILE_TYPE_H
 
 #include "core/Serializable.hpp"
+#include "core/PropertyPack.hpp"
 
-struct TileType : public pg::Serializable
+struct TileType
 {
     public:
         TileType():
@@ -16,20 +17,59 @@ struct TileType : public pg::Serializable
         {
         }
 
-        pg::InputStream &Deserialize(pg::InputStream &stream)
+        bool operator==(const TileType &b) const
         {
-            stream >> island;
-            return stream;
-        }
-        
-        pg::OutputStream &Serialize(pg::OutputStream &stream) const
-        {
-            stream << island;
-            return stream;
+            return island == b.island;
         }
 
         bool island;
 };
 
+namespace pg
+{
+    template<>
+    struct Serializer<TileType>
+    {
+        static void Serialize(OutputStream &stream, const TileType &x)
+        {
+            stream << x.island;
+        }
+
+        static void Deserialize(InputStream &stream, TileType &x)
+        {
+            stream >> x.island;
+        }
+    };
+
+    /* One bit per site */
+    template<>
+    class PropertyPack<TileType>
+    {
+        public:
+            void Resize(size_t size)
+            {
+                island.resize(size);
+            }
+
+            TileType Get(size_t index) const
+            {
+                return TileType(island[index]);
+            }
+
+            void Set(size_t index, const TileType &property)
+            {
+                island[index] = property.island;
+            }
+
+            size_t MemoryUsage() const
+            {
+                return (island.capacity() + 7) / 8;
+            }
+
+        protected:
+            std::vector<bool> island;
+    };
+}
+
 #endif
 
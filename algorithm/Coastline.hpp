@@ -0,0 +1,375 @@
+#ifndef COASTLINE_HPP
+#define COASTLINE_HPP
+
+#include <array>
+#include <map>
+#include <vector>
+#include <utility>
+#include <cmath>
+#include <algorithm>
+
+#include "VoronoiMesh.hpp"
+
+namespace pg
+{
+    template<typename T>
+    using Polyline = std::vector<VPoint<T>>;
+
+    /* Coastlines of one tile. Land is always on the left of a polyline
+     * when going along it with y pointing down. Closed polylines end with
+     * their first point, open ones start and end on the tile border. */
+    template<typename T>
+    class CoastlineTile
+    {
+        public:
+            std::vector<Polyline<T>> &Polylines()
+            {
+                return polylines;
+            }
+
+            const std::vector<Polyline<T>> &Polylines() const
+            {
+                return polylines;
+            }
+
+            size_t SegmentCount() const
+            {
+                size_t count = 0;
+                for(const auto &polyline : polylines)
+                    count += polyline.size() - 1;
+                return count;
+            }
+
+        protected:
+            std::vector<Polyline<T>> polylines;
+    };
+
+    /* Coastlines of the sites of a mesh, extracted per tile by marching
+     * squares and cached like the tiles themselves. Land is sampled
+     * samplesPerCell times per sub-cell in each direction on a grid shared
+     * by every tile, crossings are then refined by bisection and the
+     * polylines simplified within tolerance. Tiles compute the exact same
+     * points on the borders they share, which is what Coastlines() uses
+     * to stitch them together. Features thinner than the sample spacing
+     * may be missed. */
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>,
+             typename Inside = PropertyIsland>
+    class CoastlineMesh :
+        public pg::Incrementable<CoastlineTile<T>, 2>
+    {
+        public:
+            typedef CoastlineTile<T> Tile;
+
+            CoastlineMesh(pg::NumberGenerator &ngenerator,
+                          VoronoiMesh<T, P, Metric> &sourceMesh,
+                          size_t samplesPerCell = 2, T t = T(.5)):
+                pg::Incrementable<Tile, 2>(ngenerator),
+                source(sourceMesh),
+                samplesX(sourceMesh.TileDensityX()
+                         * std::max<size_t>(samplesPerCell, 1)),
+                samplesY(sourceMesh.TileDensityY()
+                         * std::max<size_t>(samplesPerCell, 1)),
+                paceX(sourceMesh.UnitX() / samplesX),
+                paceY(sourceMesh.UnitY() / samplesY),
+                tolerance(t)
+            {
+            }
+
+            virtual ~CoastlineMesh() = default;
+
+            /* Appends the coastlines of the tiles of [minCoord, maxCoord]
+             * to polylines, joined across tile borders. Polylines leaving
+             * the region stay open. */
+            void Coastlines(const std::array<int, 2> &minCoord,
+                            const std::array<int, 2> &maxCoord,
+                            std::vector<Polyline<T>> &polylines)
+            {
+                typedef std::pair<T, T> Key;
+                std::vector<const Polyline<T>*> open;
+                std::map<Key, size_t> starts;
+                std::map<Key, size_t> ends;
+                for(int y = minCoord[1]; y <= maxCoord[1]; ++y)
+                    for(int x = minCoord[0]; x <= maxCoord[0]; ++x)
+                        for(const auto &polyline : this->At({{x, y}})
+                                                       .Polylines())
+                        {
+                            if(isClosed(polyline))
+                            {
+                                polylines.push_back(polyline);
+                                continue;
+                            }
+
+                            starts[key(polyline.front())] = open.size();
+                            ends[key(polyline.back())] = open.size();
+                            open.push_back(&polyline);
+                        }
+
+                // Chains start where no other polyline ends, the ones left
+                // afterwards loop over several tiles
+                std::vector<bool> used(open.size(), false);
+                for(size_t pass = 0; pass < 2; ++pass)
+                    for(size_t i = 0; i < open.size(); ++i)
+                    {
+                        if(used[i] || (pass == 0
+                        && ends.count(key(open[i]->front())) != 0))
+                            continue;
+
+                        Polyline<T> chain;
+                        for(size_t j = i; !used[j];)
+                        {
+                            used[j] = true;
+                            chain.insert(chain.end(),
+                                         open[j]->begin()
+                                             + (chain.empty() ? 0 : 1),
+                                         open[j]->end());
+                            auto next = starts.find(key(open[j]->back()));
+                            if(next == starts.end())
+                                break;
+                            j = next->second;
+                        }
+                        polylines.push_back(std::move(chain));
+                    }
+            }
+
+            /* Drops the tiles whose coastlines depend on the source tile at
+             * coord, to be called when it is modified */
+            void Invalidate(const std::array<int, 2> &coord)
+            {
+                for(int y = coord[1] - 1; y <= coord[1] + 1; ++y)
+                    for(int x = coord[0] - 1; x <= coord[0] + 1; ++x)
+                        this->tiles.erase(std::array<int, 2>{{x, y}});
+            }
+
+        protected:
+            static const size_t REFINE_STEPS = 6;
+
+            static std::pair<T, T> key(const VPoint<T> &point)
+            {
+                return {point.x, point.y};
+            }
+
+            static bool isClosed(const Polyline<T> &polyline)
+            {
+                return polyline.front().x == polyline.back().x
+                    && polyline.front().y == polyline.back().y;
+            }
+
+            bool inside(const VPoint<T> &point)
+            {
+                return Inside()(source.SiteAt(point).properties);
+            }
+
+            /* Point of the global sample grid */
+            VPoint<T> sample(long x, long y) const
+            {
+                return VPoint<T>(x * paceX, y * paceY);
+            }
+
+            /* Boundary between sample a and the next one in the direction
+             * (dx, dy), which are on different sides of it. Only depends on
+             * the edge, not on the tile asking for it. */
+            VPoint<T> crossing(long x, long y, long dx, long dy)
+            {
+                VPoint<T> a = sample(x, y);
+                VPoint<T> b = sample(x + dx, y + dy);
+                bool insideA = inside(a);
+                T low = 0;
+                T high = 1;
+                for(size_t i = 0; i < REFINE_STEPS; ++i)
+                {
+                    T middle = (low + high) / 2;
+                    VPoint<T> point(a.x + (b.x - a.x) * middle,
+                                    a.y + (b.y - a.y) * middle);
+                    if(inside(point) == insideA)
+                        low = middle;
+                    else
+                        high = middle;
+                }
+
+                T middle = (low + high) / 2;
+                return VPoint<T>(a.x + (b.x - a.x) * middle,
+                                 a.y + (b.y - a.y) * middle);
+            }
+
+            Tile &increment(const std::array<int, 2> &coord)
+            {
+                long width = samplesX;
+                long height = samplesY;
+                long originX = coord[0] * width;
+                long originY = coord[1] * height;
+
+                std::vector<bool> land((width + 1) * (height + 1));
+                for(long y = 0; y <= height; ++y)
+                    for(long x = 0; x <= width; ++x)
+                    {
+                        land[x + y * (width + 1)] =
+                            inside(sample(originX + x, originY + y));
+                    }
+
+                // Horizontal edges first, then vertical ones, each crossed
+                // edge linking the segment of the cell it enters to the
+                // segment of the cell it leaves
+                long horizontal = width * (height + 1);
+                std::vector<long> next(horizontal + (width + 1) * height,
+                                       -1);
+                std::vector<bool> entered(next.size(), false);
+                for(long y = 0; y < height; ++y)
+                    for(long x = 0; x < width; ++x)
+                    {
+                        // Corners and edges clockwise from the top left
+                        bool corners[4] = {
+                            land[x + y * (width + 1)],
+                            land[x + 1 + y * (width + 1)],
+                            land[x + 1 + (y + 1) * (width + 1)],
+                            land[x + (y + 1) * (width + 1)]};
+                        long edges[4] = {
+                            x + y * width,
+                            horizontal + x + 1 + y * (width + 1),
+                            x + (y + 1) * width,
+                            horizontal + x + y * (width + 1)};
+
+                        // A saddle joins the land corners when the center
+                        // of the cell is land
+                        size_t landCount = std::count(corners, corners + 4,
+                                                      true);
+                        bool joined = landCount == 2 && corners[0]
+                            == corners[2] && inside(VPoint<T>(
+                                (originX + x + T(.5)) * paceX,
+                                (originY + y + T(.5)) * paceY));
+
+                        for(size_t e = 0; e < 4; ++e)
+                        {
+                            // Water to land going clockwise
+                            if(corners[e] || !corners[(e + 1) % 4])
+                                continue;
+
+                            // Land to water edge, which a saddle pairs
+                            // so as to cut the water corners off when
+                            // joined and the land corners otherwise
+                            size_t exit = (e + 1) % 4;
+                            if(landCount == 2 && corners[0] == corners[2])
+                                exit = joined ? (e + 3) % 4 : (e + 1) % 4;
+                            else
+                                while(!corners[exit]
+                                   || corners[(exit + 1) % 4])
+                                    exit = (exit + 1) % 4;
+                            next[edges[e]] = edges[exit];
+                            entered[edges[exit]] = true;
+                        }
+                    }
+
+                Tile tile;
+                std::vector<bool> visited(next.size(), false);
+                for(size_t pass = 0; pass < 2; ++pass)
+                    for(long e = 0; e < long(next.size()); ++e)
+                    {
+                        // Open polylines first, starting on the border
+                        if(next[e] < 0 || visited[e]
+                        || (pass == 0 && entered[e]))
+                            continue;
+
+                        Polyline<T> polyline;
+                        long edge = e;
+                        while(edge >= 0 && !visited[edge])
+                        {
+                            visited[edge] = true;
+                            polyline.push_back(edgeCrossing(edge, originX,
+                                                            originY));
+                            edge = next[edge];
+                        }
+                        if(edge >= 0) // Closed
+                            polyline.push_back(polyline.front());
+                        else if(polyline.size() < 2)
+                            continue;
+
+                        tile.Polylines().push_back(simplify(polyline));
+                    }
+
+                return this->tiles.insert({coord, std::move(tile)})
+                    .first->second;
+            }
+
+            VPoint<T> edgeCrossing(long edge, long originX, long originY)
+            {
+                long width = samplesX;
+                long horizontal = width * (samplesY + 1);
+                if(edge < horizontal)
+                    return crossing(originX + edge % width,
+                                    originY + edge / width, 1, 0);
+
+                edge -= horizontal;
+                return crossing(originX + edge % (width + 1),
+                                originY + edge / (width + 1), 0, 1);
+            }
+
+            /* Douglas-Peucker, keeping both ends so that borders match */
+            Polyline<T> simplify(const Polyline<T> &polyline) const
+            {
+                std::vector<bool> keep(polyline.size(), false);
+                keep.front() = true;
+                keep.back() = true;
+
+                std::vector<std::pair<size_t, size_t>> ranges = {
+                    {0, polyline.size() - 1}};
+                while(!ranges.empty())
+                {
+                    size_t first = ranges.back().first;
+                    size_t last = ranges.back().second;
+                    ranges.pop_back();
+
+                    T maxDistance = tolerance;
+                    size_t farthest = first;
+                    for(size_t i = first + 1; i < last; ++i)
+                    {
+                        T distance = segmentDistance(polyline[i],
+                                                     polyline[first],
+                                                     polyline[last]);
+                        if(distance > maxDistance)
+                        {
+                            maxDistance = distance;
+                            farthest = i;
+                        }
+                    }
+
+                    if(farthest != first)
+                    {
+                        keep[farthest] = true;
+                        ranges.push_back({first, farthest});
+                        ranges.push_back({farthest, last});
+                    }
+                }
+
+                Polyline<T> simplified;
+                for(size_t i = 0; i < polyline.size(); ++i)
+                    if(keep[i])
+                        simplified.push_back(polyline[i]);
+                return simplified;
+            }
+
+            static T segmentDistance(const VPoint<T> &point,
+                                     const VPoint<T> &a, const VPoint<T> &b)
+            {
+                T dx = b.x - a.x;
+                T dy = b.y - a.y;
+                T length2 = dx * dx + dy * dy;
+                T t = 0;
+                if(length2 > 0)
+                {
+                    t = ((point.x - a.x) * dx + (point.y - a.y) * dy)
+                      / length2;
+                    t = std::max(T(0), std::min(t, T(1)));
+                }
+                return std::sqrt(dist2(point, VPoint<T>(a.x + t * dx,
+                                                        a.y + t * dy)));
+            }
+
+            VoronoiMesh<T, P, Metric> &source;
+            size_t samplesX;
+            size_t samplesY;
+            T paceX;
+            T paceY;
+            T tolerance;
+    };
+}
+
+#endif
@@ -0,0 +1,277 @@
+#ifndef COMPACT_VORONOI_TILE_HPP
+#define COMPACT_VORONOI_TILE_HPP
+
+#include <array>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include "VoronoiMesh.hpp"
+#include "../core/PropertyPack.hpp"
+
+namespace pg
+{
+    /* Maps a position inside a sub-cell of size pace to an unsigned integer
+     * Q and back to the center of the matching bucket */
+    template<typename T, typename Q>
+    struct SubcellQuantizer
+    {
+        static const uint64_t LEVELS =
+            static_cast<uint64_t>(std::numeric_limits<Q>::max()) + 1;
+
+        static Q Encode(T value, T cellMin, T pace)
+        {
+            T fraction = (value - cellMin) / pace;
+            if(!(fraction > 0))
+                return 0;
+            uint64_t q = static_cast<uint64_t>(fraction * LEVELS);
+            return static_cast<Q>(std::min<uint64_t>(q, LEVELS - 1));
+        }
+
+        static T Decode(Q q, T cellMin, T pace)
+        {
+            return cellMin + pace * (q + T(.5)) / LEVELS;
+        }
+    };
+
+    /* Sub-cells of the tiles of a mesh, which every CompactVoronoiTile of
+     * the mesh is decoded with */
+    template<typename T>
+    struct CompactTileGrid
+    {
+        CompactTileGrid(size_t tDensityX, size_t tDensityY, T uX, T uY):
+            densityX(tDensityX),
+            densityY(tDensityY),
+            unitX(uX),
+            unitY(uY),
+            paceX(uX / tDensityX),
+            paceY(uY / tDensityY)
+        {
+        }
+
+        T CellMinX(const std::array<int, 2> &coord, size_t index) const
+        {
+            return coord[0] * unitX + paceX * (index % densityX);
+        }
+
+        T CellMinY(const std::array<int, 2> &coord, size_t index) const
+        {
+            return coord[1] * unitY + paceY * (index / densityX);
+        }
+
+        size_t densityX;
+        size_t densityY;
+        T unitX;
+        T unitY;
+        T paceX;
+        T paceY;
+    };
+
+    /* Read-only tile storing every site as a Q offset per axis inside its
+     * own sub-cell, and properties in a PropertyPack. Positions are decoded
+     * on the fly from the coordinates of the tile and the grid of its mesh,
+     * to within pace / 2^(8 sizeof(Q) + 1). */
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>,
+             typename Q = uint16_t>
+    class CompactVoronoiTile
+    {
+        public:
+            typedef SubcellQuantizer<T, Q> Quantizer;
+            typedef CompactTileGrid<T> Grid;
+            typedef std::array<int, 2> Coord;
+
+            CompactVoronoiTile() = default;
+
+            CompactVoronoiTile(const VoronoiTile<T, P, Metric> &tile,
+                               const Coord &coord, const Grid &grid)
+            {
+                const auto &sites = tile.Sites();
+                if(sites.size() != grid.densityX * grid.densityY)
+                {
+                    throw std::runtime_error("CompactVoronoiTile needs one "
+                                             "site per sub-cell");
+                }
+
+                offsets.resize(2 * sites.size());
+                properties.Resize(sites.size());
+                for(size_t i = 0; i < sites.size(); ++i)
+                {
+                    offsets[2*i  ] = Quantizer::Encode(sites[i].point.x,
+                        grid.CellMinX(coord, i), grid.paceX);
+                    offsets[2*i+1] = Quantizer::Encode(sites[i].point.y,
+                        grid.CellMinY(coord, i), grid.paceY);
+                    properties.Set(i, sites[i].properties);
+                }
+            }
+
+            size_t SiteCount() const
+            {
+                return offsets.size() / 2;
+            }
+
+            VPoint<T> Point(size_t index, const Coord &coord,
+                            const Grid &grid) const
+            {
+                return VPoint<T>(
+                    Quantizer::Decode(offsets[2*index  ],
+                                      grid.CellMinX(coord, index),
+                                      grid.paceX),
+                    Quantizer::Decode(offsets[2*index+1],
+                                      grid.CellMinY(coord, index),
+                                      grid.paceY));
+            }
+
+            VoronoiSite<T, P> Site(size_t index, const Coord &coord,
+                                   const Grid &grid) const
+            {
+                VoronoiSite<T, P> site;
+                site.point = Point(index, coord, grid);
+                site.properties = properties.Get(index);
+                return site;
+            }
+
+            VoronoiSite<T, P> SiteAt(const VPoint<T> &point,
+                                     const Coord &coord, const Grid &grid,
+                                     size_t &index, T &distance) const
+            {
+                if(SiteCount() == 0)
+                {
+                    throw std::runtime_error("CompactVoronoiTile should have "
+                                             "at least one site");
+                }
+
+                // Properties are only decoded for the winner, unless the
+                // metric needs them
+                const bool readProperties =
+                    MetricReadsProperties<Metric>::value;
+                index = 0;
+                VoronoiSite<T, P> site;
+                site.point = Point(0, coord, grid);
+                if(readProperties)
+                    site.properties = properties.Get(0);
+                T minDistance = Metric::Distance(point, site);
+
+                for(size_t i = 1; i < SiteCount(); ++i)
+                {
+                    site.point = Point(i, coord, grid);
+                    if(readProperties)
+                        site.properties = properties.Get(i);
+
+                    T tmp = Metric::Distance(point, site);
+                    if(tmp < minDistance)
+                    {
+                        minDistance = tmp;
+                        index = i;
+                    }
+                }
+                distance = minDistance;
+
+                return Site(index, coord, grid);
+            }
+
+            VoronoiTile<T, P, Metric> Decode(const Coord &coord,
+                                             const Grid &grid) const
+            {
+                std::vector<VoronoiSite<T, P>> sites(SiteCount());
+                for(size_t i = 0; i < sites.size(); ++i)
+                    sites[i] = Site(i, coord, grid);
+                return VoronoiTile<T, P, Metric>(sites);
+            }
+
+            size_t MemoryUsage() const
+            {
+                return sizeof(*this) + offsets.capacity() * sizeof(Q)
+                     + properties.MemoryUsage();
+            }
+
+        protected:
+            std::vector<Q> offsets;
+            PropertyPack<P> properties;
+    };
+
+    /* Same queries as VoronoiMesh over compact tiles, which are generated
+     * by source and then quantized. Sites are returned by value since they
+     * are decoded on the fly. */
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>,
+             typename Q = uint16_t>
+    class CompactVoronoiMesh :
+        public pg::Incrementable<CompactVoronoiTile<T, P, Metric, Q>, 2>
+    {
+        public:
+            typedef CompactVoronoiTile<T, P, Metric, Q> Tile;
+
+            CompactVoronoiMesh(pg::NumberGenerator &ngenerator,
+                               VoronoiMesh<T, P, Metric> &sourceMesh):
+                pg::Incrementable<Tile, 2>(ngenerator),
+                source(sourceMesh),
+                grid(sourceMesh.TileDensityX(), sourceMesh.TileDensityY(),
+                     sourceMesh.UnitX(), sourceMesh.UnitY())
+            {
+            }
+
+            virtual ~CompactVoronoiMesh() = default;
+
+            const CompactTileGrid<T> &Grid() const
+            {
+                return grid;
+            }
+
+            VoronoiSite<T, P> SiteAt(const VPoint<T> &point)
+            {
+                int tileX = std::floor(point.x / grid.unitX);
+                int tileY = std::floor(point.y / grid.unitY);
+                std::array<int, 2> coord = {{tileX, tileY}};
+                const Tile &tile = this->At(coord);
+
+                size_t subtileIndex;
+                T distance;
+                VoronoiSite<T, P> site = tile.SiteAt(point, coord, grid,
+                                                     subtileIndex, distance);
+
+                size_t subtileX = subtileIndex % grid.densityX;
+                size_t subtileY = subtileIndex / grid.densityX;
+
+                std::vector<std::array<int, 2>> borderTiles;
+                if(subtileX == 0) // Left border
+                    borderTiles.push_back({{tileX-1, tileY}});
+                else if(subtileX + 1 == grid.densityX) // Right border
+                    borderTiles.push_back({{tileX+1, tileY}});
+
+                if(subtileY == 0) // Upper border
+                    borderTiles.push_back({{tileX, tileY-1}});
+                else if(subtileY + 1 == grid.densityY) // Lower border
+                    borderTiles.push_back({{tileX, tileY+1}});
+
+                // Keep the closest candidate to the point
+                for(const auto &borderCoord : borderTiles)
+                {
+                    T borderDistance;
+                    VoronoiSite<T, P> borderSite =
+                        this->At(borderCoord).SiteAt(point, borderCoord,
+                            grid, subtileIndex, borderDistance);
+                    if(borderDistance < distance)
+                    {
+                        distance = borderDistance;
+                        site = borderSite;
+                    }
+                }
+
+                return site;
+            }
+
+        protected:
+            Tile &increment(const std::array<int, 2> &coord)
+            {
+                Tile tile(source.GenerateTile(coord), coord, grid);
+                return this->tiles.insert({coord, std::move(tile)})
+                    .first->second;
+            }
+
+            VoronoiMesh<T, P, Metric> &source;
+            CompactTileGrid<T> grid;
+    };
+}
+
+#endif
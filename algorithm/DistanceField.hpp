@@ -0,0 +1,300 @@
+#ifndef DISTANCE_FIELD_HPP
+#define DISTANCE_FIELD_HPP
+
+#include <array>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "VoronoiMesh.hpp"
+#include "../core/ThreadPool.hpp"
+
+namespace pg
+{
+    /* Grid of distances of one tile, each one quantized to a signed
+     * integer Q over [-range, range], to within range / 2^(8 sizeof(Q)) */
+    template<typename T, typename Q = int8_t>
+    class DistanceTile
+    {
+        public:
+            DistanceTile():
+                width(0),
+                height(0),
+                range(0)
+            {
+            }
+
+            DistanceTile(size_t w, size_t h, T r):
+                width(w),
+                height(h),
+                range(r),
+                values(w * h)
+            {
+            }
+
+            size_t Width() const
+            {
+                return width;
+            }
+
+            size_t Height() const
+            {
+                return height;
+            }
+
+            T Get(size_t x, size_t y) const
+            {
+                return values[x + y * width] * range
+                     / std::numeric_limits<Q>::max();
+            }
+
+            /* Clamps distance to [-range, range] */
+            void Set(size_t x, size_t y, T distance)
+            {
+                T limit = std::numeric_limits<Q>::max();
+                T value = std::round(distance / range * limit);
+                values[x + y * width] = std::max(-limit, std::min(value,
+                                                                  limit));
+            }
+
+            size_t MemoryUsage() const
+            {
+                return sizeof(*this) + values.capacity() * sizeof(Q);
+            }
+
+        protected:
+            size_t width;
+            size_t height;
+            T range;
+            std::vector<Q> values;
+    };
+
+    /* Signed distance to the coast of a mesh, positive at sea and negative
+     * on land, up to maxDistance. It is sampled samplesPerCell times per
+     * sub-cell in each direction on a grid shared by every tile, each tile
+     * holding the samples of its borders as well so that Distance() only
+     * reads one tile. Distances are accurate to about one sample spacing.
+     *
+     * Each tile is computed over an apron of maxDistance around it, so
+     * that land in the neighbouring tiles is accounted for, by an exact
+     * Euclidean distance transform: one sweep per column, then one per
+     * row, both split over the pool. */
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>,
+             typename Inside = PropertyIsland, typename Q = int8_t>
+    class DistanceFieldMesh :
+        public pg::Incrementable<DistanceTile<T, Q>, 2>
+    {
+        public:
+            typedef DistanceTile<T, Q> Tile;
+
+            DistanceFieldMesh(pg::NumberGenerator &ngenerator,
+                              VoronoiMesh<T, P, Metric> &sourceMesh,
+                              pg::ThreadPool &threadPool, T maxDistance,
+                              size_t samplesPerCell = 2):
+                pg::Incrementable<Tile, 2>(ngenerator),
+                source(sourceMesh),
+                pool(threadPool),
+                samplesX(sourceMesh.TileDensityX()
+                         * std::max<size_t>(samplesPerCell, 1)),
+                samplesY(sourceMesh.TileDensityY()
+                         * std::max<size_t>(samplesPerCell, 1)),
+                paceX(sourceMesh.UnitX() / samplesX),
+                paceY(sourceMesh.UnitY() / samplesY),
+                range(maxDistance),
+                apronX(std::ceil(maxDistance / paceX)),
+                apronY(std::ceil(maxDistance / paceY))
+            {
+            }
+
+            virtual ~DistanceFieldMesh() = default;
+
+            /* Bilinear interpolation of the samples around point */
+            T Distance(const VPoint<T> &point)
+            {
+                T x = point.x / paceX;
+                T y = point.y / paceY;
+                long sampleX = std::floor(x);
+                long sampleY = std::floor(y);
+                long tileX = floorDiv(sampleX, samplesX);
+                long tileY = floorDiv(sampleY, samplesY);
+                const Tile &tile = this->At({{int(tileX), int(tileY)}});
+
+                size_t localX = sampleX - tileX * long(samplesX);
+                size_t localY = sampleY - tileY * long(samplesY);
+                T fx = x - sampleX;
+                T fy = y - sampleY;
+                T top = tile.Get(localX, localY) * (1 - fx)
+                      + tile.Get(localX + 1, localY) * fx;
+                T bottom = tile.Get(localX, localY + 1) * (1 - fx)
+                         + tile.Get(localX + 1, localY + 1) * fx;
+                return top * (1 - fy) + bottom * fy;
+            }
+
+            T MaxDistance() const
+            {
+                return range;
+            }
+
+            /* Drops the tiles whose distances depend on the source tile at
+             * coord, to be called when it is modified */
+            void Invalidate(const std::array<int, 2> &coord)
+            {
+                long marginX = apronX / samplesX + 1;
+                long marginY = apronY / samplesY + 1;
+                for(long y = coord[1] - marginY; y <= coord[1] + marginY; ++y)
+                    for(long x = coord[0] - marginX; x <= coord[0] + marginX;
+                        ++x)
+                        this->tiles.erase(std::array<int, 2>{{int(x),
+                                                              int(y)}});
+            }
+
+        protected:
+            static long floorDiv(long a, long b)
+            {
+                return a >= 0 ? a / b : -((-a + b - 1) / b);
+            }
+
+            /* Squared distance transform of the n values of f spaced by
+             * pace, in place: f[i] becomes the minimum over j of
+             * f[j] + ((i - j) pace)^2. From "Distance Transforms of Sampled
+             * Functions", Felzenszwalb and Huttenlocher. */
+            static void transform(std::vector<T> &f, T pace)
+            {
+                size_t n = f.size();
+                std::vector<size_t> parabolas(n);
+                std::vector<T> bounds(n + 1);
+                std::vector<T> result(n);
+
+                // Lower envelope of the parabolas rooted at each sample,
+                // bounds[k] being where parabola k starts being the lowest
+                auto intersection = [&](size_t q, size_t v)
+                {
+                    T x = q * pace;
+                    T y = v * pace;
+                    return ((f[q] + x * x) - (f[v] + y * y)) / (2 * (x - y));
+                };
+
+                size_t k = 0;
+                parabolas[0] = 0;
+                bounds[0] = -std::numeric_limits<T>::infinity();
+                bounds[1] = std::numeric_limits<T>::infinity();
+                for(size_t q = 1; q < n; ++q)
+                {
+                    T s = intersection(q, parabolas[k]);
+                    while(s <= bounds[k])
+                        s = intersection(q, parabolas[--k]);
+
+                    parabolas[++k] = q;
+                    bounds[k] = s;
+                    bounds[k + 1] = std::numeric_limits<T>::infinity();
+                }
+
+                k = 0;
+                for(size_t q = 0; q < n; ++q)
+                {
+                    while(bounds[k + 1] < q * pace)
+                        ++k;
+                    T d = (T(q) - T(parabolas[k])) * pace;
+                    result[q] = d * d + f[parabolas[k]];
+                }
+                f.swap(result);
+            }
+
+            Tile &increment(const std::array<int, 2> &coord)
+            {
+                long width = samplesX + 1 + 2 * apronX;
+                long height = samplesY + 1 + 2 * apronY;
+                long originX = coord[0] * long(samplesX) - long(apronX);
+                long originY = coord[1] * long(samplesY) - long(apronY);
+
+                // FindSiteAt() looks at most one tile away
+                std::array<int, 2> minCoord = {{
+                    int(floorDiv(originX, samplesX) - 1),
+                    int(floorDiv(originY, samplesY) - 1)}};
+                std::array<int, 2> maxCoord = {{
+                    int(floorDiv(originX + width - 1, samplesX) + 1),
+                    int(floorDiv(originY + height - 1, samplesY) + 1)}};
+                source.GenerateRegion(minCoord, maxCoord, pool);
+
+                // Bytes rather than bits, since rows are written concurrently
+                std::vector<uint8_t> land(width * height);
+                const VoronoiMesh<T, P, Metric> &constSource = source;
+                ParallelFor(pool, height, [&](size_t y)
+                {
+                    for(long x = 0; x < width; ++x)
+                    {
+                        VPoint<T> point((originX + x) * paceX,
+                                        (originY + long(y)) * paceY);
+                        land[x + y * width] = Inside()(
+                            constSource.FindSiteAt(point)->properties);
+                    }
+                });
+
+                // Squared distances to the closest land sample, then to the
+                // closest water sample, beyond the apron being unknown
+                T far = (width * paceX) * (width * paceX)
+                      + (height * paceY) * (height * paceY);
+                std::vector<T> toLand(width * height);
+                std::vector<T> toWater(width * height);
+                ParallelFor(pool, width, [&](size_t x)
+                {
+                    std::vector<T> landColumn(height);
+                    std::vector<T> waterColumn(height);
+                    for(long y = 0; y < height; ++y)
+                    {
+                        landColumn[y] = land[x + y * width] ? 0 : far;
+                        waterColumn[y] = land[x + y * width] ? far : 0;
+                    }
+                    transform(landColumn, paceY);
+                    transform(waterColumn, paceY);
+                    for(long y = 0; y < height; ++y)
+                    {
+                        toLand[x + y * width] = landColumn[y];
+                        toWater[x + y * width] = waterColumn[y];
+                    }
+                });
+
+                // The coast lies between samples, half a sample away from
+                // the closest one on the other side
+                T halfPace = std::min(paceX, paceY) / 2;
+                Tile tile(samplesX + 1, samplesY + 1, range);
+                ParallelFor(pool, samplesY + 1, [&](size_t y)
+                {
+                    size_t row = (y + apronY) * width;
+                    std::vector<T> landRow(toLand.begin() + row,
+                                           toLand.begin() + row + width);
+                    std::vector<T> waterRow(toWater.begin() + row,
+                                            toWater.begin() + row + width);
+                    transform(landRow, paceX);
+                    transform(waterRow, paceX);
+                    for(size_t x = 0; x <= samplesX; ++x)
+                    {
+                        size_t i = x + apronX;
+                        if(land[i + row])
+                            tile.Set(x, y, halfPace
+                                         - std::sqrt(waterRow[i]));
+                        else
+                            tile.Set(x, y, std::sqrt(landRow[i])
+                                         - halfPace);
+                    }
+                });
+
+                return this->tiles.insert({coord, std::move(tile)})
+                    .first->second;
+            }
+
+            VoronoiMesh<T, P, Metric> &source;
+            pg::ThreadPool &pool;
+            size_t samplesX;
+            size_t samplesY;
+            T paceX;
+            T paceY;
+            T range;
+            size_t apronX;
+            size_t apronY;
+    };
+}
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef FIELD_LAYER_HPP
+#define FIELD_LAYER_HPP
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "VoronoiUtils.hpp"
+
+namespace pg
+{
+    /* Values of a field sampled over one tile, resolution + 1 times in
+     * each direction so that the samples of its borders are included */
+    template<typename V>
+    class FieldTile
+    {
+        public:
+            FieldTile():
+                resolution(0)
+            {
+            }
+
+            FieldTile(size_t r):
+                resolution(r),
+                values((r + 1) * (r + 1))
+            {
+            }
+
+            size_t Resolution() const
+            {
+                return resolution;
+            }
+
+            V &Get(size_t x, size_t y)
+            {
+                return values[x + y * (resolution + 1)];
+            }
+
+            const V &Get(size_t x, size_t y) const
+            {
+                return values[x + y * (resolution + 1)];
+            }
+
+            /* Closest sample to (x, y), in [0, 1] across the tile */
+            template<typename T>
+            const V &Nearest(T x, T y) const
+            {
+                return Get(std::lround(clamp(x) * resolution),
+                           std::lround(clamp(y) * resolution));
+            }
+
+            /* Bilinear interpolation at (x, y), in [0, 1] across the tile,
+             * for arithmetic values */
+            template<typename T>
+            T Bilinear(T x, T y) const
+            {
+                x = clamp(x) * resolution;
+                y = clamp(y) * resolution;
+                size_t x0 = std::min<size_t>(x, resolution - 1);
+                size_t y0 = std::min<size_t>(y, resolution - 1);
+                T fx = x - x0;
+                T fy = y - y0;
+                T top = Get(x0, y0) * (1 - fx) + Get(x0 + 1, y0) * fx;
+                T bottom = Get(x0, y0 + 1) * (1 - fx)
+                         + Get(x0 + 1, y0 + 1) * fx;
+                return top * (1 - fy) + bottom * fy;
+            }
+
+        protected:
+            template<typename T>
+            static T clamp(T value)
+            {
+                return std::max(T(0), std::min(value, T(1)));
+            }
+
+            size_t resolution;
+            std::vector<V> values;
+    };
+
+    /* Layer of a LayeredMap sampling field(point) over unitX x unitY
+     * tiles, at resolution + 1 points per tile in each direction */
+    template<typename T, typename V, typename Field>
+    class FieldLayer
+    {
+        public:
+            typedef FieldTile<V> Tile;
+
+            FieldLayer(Field f, T uX, T uY, size_t r):
+                field(f),
+                unitX(uX),
+                unitY(uY),
+                resolution(r)
+            {
+            }
+
+            Tile operator()(const std::array<int, 2> &coord)
+            {
+                Tile tile(resolution);
+                for(size_t y = 0; y <= resolution; ++y)
+                    for(size_t x = 0; x <= resolution; ++x)
+                    {
+                        VPoint<T> point(
+                            (coord[0] + T(x) / resolution) * unitX,
+                            (coord[1] + T(y) / resolution) * unitY);
+                        tile.Get(x, y) = field(point);
+                    }
+                return tile;
+            }
+
+        protected:
+            Field field;
+            T unitX;
+            T unitY;
+            size_t resolution;
+    };
+
+    /* Deduces the type of field, e.g. a lambda */
+    template<typename T, typename V, typename Field>
+    FieldLayer<T, V, Field> MakeFieldLayer(Field field, T unitX, T unitY,
+                                           size_t resolution)
+    {
+        return FieldLayer<T, V, Field>(field, unitX, unitY, resolution);
+    }
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef MESH_RENDERER_HPP
+#define MESH_RENDERER_HPP
+
+#include <cmath>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "VoronoiMesh.hpp"
+#include "../core/Image.hpp"
+#include "../core/ThreadPool.hpp"
+
+namespace pg
+{
+    /* Generates every tile that FindSiteAt() may look at to render the
+     * area of size width x height at (offsetX, offsetY) */
+    template<typename T, typename P, typename Metric>
+    void PrepareMeshArea(VoronoiMesh<T, P, Metric> &mesh,
+                         T offsetX, T offsetY, size_t width, size_t height,
+                         ThreadPool &pool)
+    {
+        // SiteAt() looks at most one tile away from the one holding the point
+        int minX = std::floor(offsetX / mesh.UnitX()) - 1;
+        int minY = std::floor(offsetY / mesh.UnitY()) - 1;
+        int maxX = std::floor((offsetX + width) / mesh.UnitX()) + 1;
+        int maxY = std::floor((offsetY + height) / mesh.UnitY()) + 1;
+        mesh.GenerateRegion({{minX, minY}}, {{maxX, maxY}}, pool);
+    }
+
+    template<typename T, typename P, typename Metric, typename Color>
+    void renderMeshRows(const VoronoiMesh<T, P, Metric> &mesh, Image &image,
+                        T offsetX, T offsetY, Color &color,
+                        size_t beginRow, size_t endRow)
+    {
+        for(size_t y = beginRow; y < endRow; ++y)
+            for(size_t x = 0; x < image.Width(); ++x)
+            {
+                VPoint<T> point;
+                point.x = x + offsetX;
+                point.y = y + offsetY;
+
+                const VoronoiSite<T, P> *site = mesh.FindSiteAt(point);
+                if(site == nullptr)
+                    throw std::logic_error("Mesh area was not prepared");
+                color(site->properties, image.Pixel(x, y));
+            }
+    }
+
+    /* Renders the area of the mesh whose top left corner is at
+     * (offsetX, offsetY) into image, one pixel per unit, rows being split
+     * over the pool. color(properties, rgba) writes the 4 bytes of a
+     * pixel, and is called concurrently. Missing tiles are generated
+     * first. */
+    template<typename T, typename P, typename Metric, typename Color>
+    void RenderMesh(VoronoiMesh<T, P, Metric> &mesh, Image &image,
+                    T offsetX, T offsetY, Color color, ThreadPool &pool)
+    {
+        PrepareMeshArea(mesh, offsetX, offsetY, image.Width(),
+                        image.Height(), pool);
+        ParallelFor(pool, image.Height(), [&](size_t y)
+        {
+            renderMeshRows(mesh, image, offsetX, offsetY, color, y, y + 1);
+        });
+    }
+
+    /* Renders any field into image: color(x, y, rgba) writes the pixel of
+     * point (x + offsetX, y + offsetY). Runs on the calling thread, since
+     * most fields (e.g. Perlin noise nodes) are generated lazily and are
+     * not thread-safe. */
+    template<typename T, typename Color>
+    void RenderField(Image &image, T offsetX, T offsetY, Color color)
+    {
+        for(size_t y = 0; y < image.Height(); ++y)
+            for(size_t x = 0; x < image.Width(); ++x)
+                color(x + offsetX, y + offsetY, image.Pixel(x, y));
+    }
+
+    /* Renders a width x height area too large to be held in memory as
+     * posterWidth x posterHeight images, rendered in parallel, one per
+     * task. write(column, row, image) is called concurrently with each
+     * finished image, the last column and row being cropped to the area.
+     * Every tile is generated before rendering starts. */
+    template<typename T, typename P, typename Metric, typename Color,
+             typename Write>
+    void RenderPoster(VoronoiMesh<T, P, Metric> &mesh,
+                      T offsetX, T offsetY, size_t width, size_t height,
+                      size_t posterWidth, size_t posterHeight,
+                      Color color, Write write, ThreadPool &pool)
+    {
+        if(posterWidth == 0 || posterHeight == 0)
+            throw std::invalid_argument("Empty poster tiles");
+
+        PrepareMeshArea(mesh, offsetX, offsetY, width, height, pool);
+
+        size_t columns = (width + posterWidth - 1) / posterWidth;
+        size_t rows = (height + posterHeight - 1) / posterHeight;
+        const VoronoiMesh<T, P, Metric> &constMesh = mesh;
+        ParallelFor(pool, columns * rows, [&](size_t i)
+        {
+            size_t column = i % columns;
+            size_t row = i / columns;
+            size_t x = column * posterWidth;
+            size_t y = row * posterHeight;
+
+            Image image(std::min(posterWidth, width - x),
+                        std::min(posterHeight, height - y));
+            renderMeshRows(constMesh, image, offsetX + x, offsetY + y,
+                           color, 0, image.Height());
+            write(column, row, static_cast<const Image&>(image));
+        });
+    }
+
+    /* Draws a polyline one pixel wide over the image of the area whose
+     * top left corner is at (offsetX, offsetY). Points outside the image
+     * are skipped. */
+    template<typename T>
+    void DrawPolyline(Image &image, T offsetX, T offsetY,
+                      const std::vector<VPoint<T>> &polyline,
+                      const uint8_t *rgba)
+    {
+        for(size_t i = 0; i + 1 < polyline.size(); ++i)
+        {
+            T dx = polyline[i + 1].x - polyline[i].x;
+            T dy = polyline[i + 1].y - polyline[i].y;
+            size_t steps = std::ceil(std::max(std::abs(dx), std::abs(dy)));
+            for(size_t step = 0; step <= steps; ++step)
+            {
+                T t = steps == 0 ? T(0) : T(step) / steps;
+                long x = std::floor(polyline[i].x + dx * t - offsetX);
+                long y = std::floor(polyline[i].y + dy * t - offsetY);
+                if(x >= 0 && y >= 0 && x < long(image.Width())
+                && y < long(image.Height()))
+                    std::copy(rgba, rgba + 4, image.Pixel(x, y));
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef SITE_GRAPH_HPP
+#define SITE_GRAPH_HPP
+
+#include <array>
+#include <map>
+#include <vector>
+#include <limits>
+#include <cmath>
+
+#include "VoronoiMesh.hpp"
+
+namespace pg
+{
+    /* Adjacency of the sites of a mesh, from the jittered grid they lie
+     * on: a site is identified by its sub-cell, in sub-cell units, and is
+     * adjacent to the sites of the 4 sub-cells sharing a side with its
+     * own. Of the two diagonals of each 2 x 2 block of sub-cells, only the
+     * one whose sites include the owner of the central corner is an edge,
+     * so the graph is planar and follows the diagram at the corners. */
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>>
+    class SiteGraph
+    {
+        public:
+            typedef std::array<long, 2> Cell;
+
+            SiteGraph(VoronoiMesh<T, P, Metric> &sourceMesh):
+                source(sourceMesh)
+            {
+            }
+
+            virtual ~SiteGraph() = default;
+
+            /* Sub-cell of the site at point */
+            Cell CellOf(const VPoint<T> &point) const
+            {
+                return {{long(std::floor(point.x * source.TileDensityX()
+                                         / source.UnitX())),
+                         long(std::floor(point.y * source.TileDensityY()
+                                         / source.UnitY()))}};
+            }
+
+            std::array<int, 2> TileOf(const Cell &cell) const
+            {
+                return {{int(floorDiv(cell[0], source.TileDensityX())),
+                         int(floorDiv(cell[1], source.TileDensityY()))}};
+            }
+
+            /* Index of the site of cell in the sites of its tile */
+            size_t IndexOf(const Cell &cell) const
+            {
+                long densityX = source.TileDensityX();
+                long densityY = source.TileDensityY();
+                std::array<int, 2> tile = TileOf(cell);
+                return cell[0] - tile[0] * densityX
+                     + (cell[1] - tile[1] * densityY) * densityX;
+            }
+
+            VoronoiSite<T, P> &Site(const Cell &cell)
+            {
+                return source.At(TileOf(cell)).Sites()[IndexOf(cell)];
+            }
+
+            /* Cells adjacent to cell. Results are written into the
+             * caller's buffer, which is cleared first, and their number is
+             * returned. */
+            size_t Neighbours(const Cell &cell, std::vector<Cell> &cells)
+            {
+                cells.clear();
+                const long SIDES[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+                for(const auto &side : SIDES)
+                    cells.push_back({{cell[0] + side[0], cell[1] + side[1]}});
+
+                const long CORNERS[4][2] = {{1, 1}, {-1, 1}, {-1, -1},
+                                            {1, -1}};
+                for(const auto &corner : CORNERS)
+                {
+                    Cell diagonal = {{cell[0] + corner[0],
+                                      cell[1] + corner[1]}};
+                    if(diagonalEdge(cell, diagonal))
+                        cells.push_back(diagonal);
+                }
+                return cells.size();
+            }
+
+        protected:
+            static long floorDiv(long a, long b)
+            {
+                return a >= 0 ? a / b : -((-a + b - 1) / b);
+            }
+
+            /* Whether the diagonal between cells a and b, which are
+             * diagonal neighbours, is the edge of their block. Sites are
+             * compared in the same order whichever end asks. */
+            bool diagonalEdge(const Cell &a, const Cell &b)
+            {
+                long minX = std::min(a[0], b[0]);
+                long minY = std::min(a[1], b[1]);
+                VPoint<T> corner(
+                    (minX + 1) * source.UnitX() / source.TileDensityX(),
+                    (minY + 1) * source.UnitY() / source.TileDensityY());
+
+                Cell owner = {{minX, minY}};
+                T minDistance = std::numeric_limits<T>::max();
+                for(long y = minY; y <= minY + 1; ++y)
+                    for(long x = minX; x <= minX + 1; ++x)
+                    {
+                        T distance = Metric::Distance(corner,
+                                                      Site({{x, y}}));
+                        if(distance < minDistance)
+                        {
+                            minDistance = distance;
+                            owner = {{x, y}};
+                        }
+                    }
+
+                return owner == a || owner == b;
+            }
+
+            VoronoiMesh<T, P, Metric> &source;
+    };
+
+    /* Connected components of the land sites of a mesh over a SiteGraph,
+     * maintained by union-find as tiles are added. Labels of sites of
+     * different tiles are merged as soon as both tiles are added, in any
+     * order. A label is the site id of the root of its island, which may
+     * change when islands merge. Land is read through Inside when a tile
+     * is added: tiles modified afterwards need a Clear(). */
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>,
+             typename Inside = PropertyIsland>
+    class IslandLabels
+    {
+        public:
+            typedef typename SiteGraph<T, P, Metric>::Cell Cell;
+
+            static const size_t NONE = std::numeric_limits<size_t>::max();
+
+            IslandLabels(VoronoiMesh<T, P, Metric> &sourceMesh):
+                source(sourceMesh),
+                graph(sourceMesh),
+                islandCount(0),
+                largest(NONE)
+            {
+            }
+
+            virtual ~IslandLabels() = default;
+
+            /* Labels the sites of the tile at coord, generating it if
+             * needed, along with the ones it needs to find adjacent
+             * sites. Does nothing if it was already added. */
+            void AddTile(const std::array<int, 2> &coord)
+            {
+                if(!bases.insert({coord, parents.size()}).second)
+                    return;
+
+                long densityX = source.TileDensityX();
+                long densityY = source.TileDensityY();
+                const auto &sites = source.At(coord).Sites();
+                for(const auto &site : sites)
+                {
+                    if(Inside()(site.properties))
+                    {
+                        parents.push_back(parents.size());
+                        ++islandCount;
+                        if(largest == NONE)
+                            largest = parents.back();
+                    }
+                    else
+                        parents.push_back(NONE);
+                    sizes.push_back(1);
+                }
+
+                std::vector<Cell> neighbours;
+                for(long y = 0; y < densityY; ++y)
+                    for(long x = 0; x < densityX; ++x)
+                    {
+                        Cell cell = {{coord[0] * densityX + x,
+                                      coord[1] * densityY + y}};
+                        size_t id = Id(cell);
+                        if(parents[id] == NONE)
+                            continue;
+
+                        graph.Neighbours(cell, neighbours);
+                        for(const auto &neighbour : neighbours)
+                        {
+                            size_t other = Id(neighbour);
+                            if(other != NONE && parents[other] != NONE)
+                                unite(id, other);
+                        }
+                    }
+            }
+
+            /* Site id of cell, NONE if its tile was not added */
+            size_t Id(const Cell &cell) const
+            {
+                auto it = bases.find(graph.TileOf(cell));
+                if(it == bases.end())
+                    return NONE;
+                return it->second + graph.IndexOf(cell);
+            }
+
+            /* Label of the site of cell, NONE for water or if its tile was
+             * not added */
+            size_t Label(const Cell &cell)
+            {
+                size_t id = Id(cell);
+                return id == NONE || parents[id] == NONE ? NONE : find(id);
+            }
+
+            size_t LabelAt(const VPoint<T> &point)
+            {
+                return Label(graph.CellOf(source.SiteAt(point).point));
+            }
+
+            /* Number of sites of the island of label */
+            size_t IslandSize(size_t label) const
+            {
+                return sizes[label];
+            }
+
+            size_t IslandCount() const
+            {
+                return islandCount;
+            }
+
+            /* Label of the island with the most sites, NONE if there is
+             * no land */
+            size_t LargestIsland()
+            {
+                if(largest != NONE)
+                    largest = find(largest);
+                return largest;
+            }
+
+            /* Forgets every tile */
+            void Clear()
+            {
+                bases.clear();
+                parents.clear();
+                sizes.clear();
+                islandCount = 0;
+                largest = NONE;
+            }
+
+            SiteGraph<T, P, Metric> &Graph()
+            {
+                return graph;
+            }
+
+        protected:
+            size_t find(size_t id)
+            {
+                // Path halving
+                while(parents[id] != id)
+                {
+                    parents[id] = parents[parents[id]];
+                    id = parents[id];
+                }
+                return id;
+            }
+
+            /* Union by size, which keeps the largest island up to date
+             * since sizes only grow */
+            void unite(size_t a, size_t b)
+            {
+                a = find(a);
+                b = find(b);
+                if(a == b)
+                    return;
+
+                if(sizes[a] < sizes[b])
+                    std::swap(a, b);
+                parents[b] = a;
+                sizes[a] += sizes[b];
+                --islandCount;
+
+                largest = find(largest);
+                if(sizes[a] > sizes[largest])
+                    largest = a;
+            }
+
+            VoronoiMesh<T, P, Metric> &source;
+            SiteGraph<T, P, Metric> graph;
+            std::map<TileCoord<2>, size_t> bases;
+            std::vector<size_t> parents;
+            std::vector<size_t> sizes;
+            size_t islandCount;
+            size_t largest;
+    };
+
+    template<typename T, typename P, typename Metric, typename Inside>
+    const size_t IslandLabels<T, P, Metric, Inside>::NONE;
+}
+
+#endif
@@ -0,0 +1,425 @@
+#ifndef VORONOI_JOURNAL_HPP
+#define VORONOI_JOURNAL_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <array>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "VoronoiWorldFile.hpp"
+#include "../core/Checksum.hpp"
+
+namespace pg
+{
+    /* Append-only log of tiles on top of a base world file, so that saving
+     * only costs the tiles generated or modified since the last save.
+     *
+     * Journal layout, every field being little-endian:
+     *   magic "PGVJ" then a world file header holding the mesh parameters
+     *   records, each made of
+     *     magic "PGJR", payload length (uint32), x, y (int32),
+     *     CRC-32 of x, y and the payload (uint32), world file tile payload
+     * Payloads are encoded as selected by the header flags, which are the
+     * ones of the base file when it exists. Recovery stops at the first
+     * torn or corrupted record. */
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>>
+    class VoronoiJournal
+    {
+        public:
+            static const uint32_t MAGIC = 0x4a564750; // "PGVJ"
+            static const uint32_t RECORD_MAGIC = 0x524a4750; // "PGJR"
+            static const size_t HEADER_SIZE =
+                4 + VoronoiWorldHeader::HEADER_SIZE;
+            static const size_t RECORD_HEADER_SIZE = 20;
+
+            /* Opens or creates the journal of mesh, and enables its dirty
+             * tracking: only tiles generated from then on are saved, so the
+             * journal should be created before generating any. baseFilename
+             * is the world file that Compact() folds the journal into.
+             * flags only apply when neither file exists yet. */
+            VoronoiJournal(const std::string &journalFilename,
+                           const std::string &baseFilename,
+                           VoronoiMesh<T, P, Metric> &mesh,
+                           uint32_t flags =
+                               VoronoiWorldHeader::FLAG_COMPRESSED):
+                journalName(journalFilename),
+                baseName(baseFilename)
+            {
+                header.scalarSize = sizeof(T);
+                header.tileDensityX = mesh.TileDensityX();
+                header.tileDensityY = mesh.TileDensityY();
+                header.unitX = mesh.UnitX();
+                header.unitY = mesh.UnitY();
+                header.seed = mesh.Seed();
+                header.relaxationIterations = mesh.RelaxationIterations();
+                header.relaxationSamples = mesh.RelaxationSamples();
+                header.flags = flags;
+                mesh.EnableDirtyTracking();
+                if(access(baseName.c_str(), F_OK) == 0)
+                {
+                    MappedFile base(baseName);
+                    VoronoiWorldHeader baseHeader;
+                    baseHeader.Parse(base.Data(), base.Size());
+                    header.flags = baseHeader.flags;
+                }
+
+                fd = open(journalName.c_str(), O_RDWR | O_CREAT, 0644);
+                if(fd < 0)
+                    throw std::runtime_error("Cannot open " + journalName);
+
+                struct stat info;
+                if(fstat(fd, &info) != 0)
+                {
+                    close(fd);
+                    throw std::runtime_error("Cannot stat " + journalName);
+                }
+
+                end = info.st_size;
+                try
+                {
+                    if(end < HEADER_SIZE)
+                        create();
+                    else
+                        validate();
+                }
+                catch(...)
+                {
+                    close(fd);
+                    throw;
+                }
+            }
+
+            virtual ~VoronoiJournal()
+            {
+                close(fd);
+            }
+
+            VoronoiJournal(const VoronoiJournal &) = delete;
+            VoronoiJournal &operator=(const VoronoiJournal &) = delete;
+
+            /* Inserts every valid record into mesh, later records replacing
+             * earlier ones, and cuts the journal after the last valid one.
+             * Meant to be called on start-up, before Save(). */
+            size_t Recover(VoronoiMesh<T, P, Metric> &mesh)
+            {
+                size_t count = 0;
+                uint64_t validEnd = forEachRecord(
+                    [&](const std::array<int, 2> &coord, const char *data,
+                        size_t length)
+                    {
+                        VoronoiTile<T, P, Metric> tile;
+                        if(!ReadWorldTile(header, coord, data, length, tile))
+                            return false;
+                        mesh.InsertTile(coord, tile);
+                        ++count;
+                        return true;
+                    });
+
+                if(validEnd < end)
+                {
+                    if(ftruncate(fd, validEnd) != 0 || fsync(fd) != 0)
+                        throw std::runtime_error("Cannot truncate "
+                                                 + journalName);
+                    end = validEnd;
+                }
+                return count;
+            }
+
+            /* Appends the dirty tiles of mesh and syncs the journal. Returns
+             * the number of tiles written. */
+            size_t Save(VoronoiMesh<T, P, Metric> &mesh)
+            {
+                std::vector<std::array<int, 2>> coords;
+                mesh.TakeDirtyTiles(coords);
+                std::sort(coords.begin(), coords.end());
+                coords.erase(std::unique(coords.begin(), coords.end()),
+                             coords.end());
+                if(coords.empty())
+                    return 0;
+
+                std::vector<char> bytes;
+                std::vector<char> data;
+                for(const auto &coord : coords)
+                {
+                    data.clear();
+                    {
+                        pg::OutputStream stream(data);
+                        WriteWorldTile(stream, header, coord, mesh.At(coord));
+                    }
+
+                    char position[8];
+                    StoreLittleEndian<int32_t>(position, coord[0]);
+                    StoreLittleEndian<int32_t>(position + 4, coord[1]);
+                    uint32_t crc = Crc32(position, sizeof(position));
+                    crc = Crc32(data.data(), data.size(), crc);
+
+                    pg::OutputStream stream(bytes);
+                    uint32_t magic = RECORD_MAGIC;
+                    stream << magic << static_cast<uint32_t>(data.size())
+                           << coord[0] << coord[1] << crc;
+                    stream.Write(data.data(), data.size());
+                }
+
+                try
+                {
+                    append(bytes, true);
+                }
+                catch(...)
+                {
+                    // Saved with the next call instead
+                    for(const auto &coord : coords)
+                        mesh.MarkDirty(coord);
+                    throw;
+                }
+                return coords.size();
+            }
+
+            /* Folds the journal into the base world file, which is created
+             * if needed, and empties the journal. The base file is replaced
+             * atomically, and replaying a journal twice is harmless, so a
+             * crash at any point loses nothing. */
+            void Compact()
+            {
+                // Latest record of every tile
+                std::map<TileCoord<2>, std::pair<uint64_t, uint64_t>> latest;
+                forEachRecord([&](const std::array<int, 2> &coord,
+                                  const char *, size_t length)
+                    {
+                        latest[coord] = std::make_pair(recordOffset
+                            + RECORD_HEADER_SIZE, length);
+                        return true;
+                    });
+
+                std::unique_ptr<MappedFile> journal(
+                    new MappedFile(journalName));
+                std::unique_ptr<MappedFile> base;
+                VoronoiWorldHeader baseHeader;
+                if(access(baseName.c_str(), F_OK) == 0)
+                {
+                    base.reset(new MappedFile(baseName));
+                    baseHeader.Parse(base->Data(), base->Size());
+                    if(!baseHeader.SameWorld(header))
+                        throw std::runtime_error("Journal does not match "
+                                                 + baseName);
+                }
+
+                std::string tmpName = baseName + ".tmp";
+                {
+                    std::ofstream file(tmpName.c_str(),
+                                       std::ios_base::out
+                                     | std::ios_base::binary);
+                    if(!file)
+                        throw std::runtime_error("Cannot open " + tmpName);
+
+                    VoronoiWorldWriter<T, P> writer(file,
+                        header.tileDensityX, header.tileDensityY,
+                        header.unitX, header.unitY, header.seed,
+                        header.flags);
+                    writer.SetRelaxation(header.relaxationIterations,
+                                         header.relaxationSamples);
+
+                    // Both sides are sorted by coordinates
+                    auto it = latest.begin();
+                    for(uint64_t i = 0; base && i < baseHeader.tileCount; ++i)
+                    {
+                        VoronoiWorldEntry entry = VoronoiWorldEntry::Load(
+                            base->Data() + baseHeader.directoryOffset
+                          + i * VoronoiWorldHeader::ENTRY_SIZE);
+                        std::array<int, 2> coord = {{entry.x, entry.y}};
+
+                        for(; it != latest.end() && it->first.coord < coord;
+                            ++it)
+                            addRecord(writer, *journal, *it);
+                        if(it != latest.end() && !(coord < it->first.coord))
+                            continue; // Replaced by the journal
+
+                        if(entry.offset > base->Size()
+                        || entry.length > base->Size() - entry.offset)
+                            throw std::runtime_error("Corrupted " + baseName);
+                        const char *payload = base->Data() + entry.offset;
+                        if(baseHeader.flags == header.flags)
+                        {
+                            writer.AddPayload(coord, payload, entry.length);
+                            continue;
+                        }
+
+                        // Base written with another encoding
+                        VoronoiTile<T, P, Metric> tile;
+                        if(!ReadWorldTile(baseHeader, coord, payload,
+                                          entry.length, tile))
+                            throw std::runtime_error("Corrupted " + baseName);
+                        writer.AddTile(coord, tile);
+                    }
+                    for(; it != latest.end(); ++it)
+                        addRecord(writer, *journal, *it);
+
+                    writer.Finish();
+                }
+                syncFile(tmpName);
+
+                if(std::rename(tmpName.c_str(), baseName.c_str()) != 0)
+                    throw std::runtime_error("Cannot replace " + baseName);
+                // The journal is only emptied once the rename is durable
+                syncFile(directoryOf(baseName));
+
+                if(ftruncate(fd, HEADER_SIZE) != 0 || fsync(fd) != 0)
+                    throw std::runtime_error("Cannot truncate " + journalName);
+                end = HEADER_SIZE;
+            }
+
+            /* Size of the journal in bytes */
+            uint64_t Size() const
+            {
+                return end;
+            }
+
+        protected:
+            /* Writes the header of an empty journal, replacing a torn one */
+            void create()
+            {
+                std::vector<char> bytes;
+                {
+                    pg::OutputStream stream(bytes);
+                    uint32_t magic = MAGIC;
+                    stream << magic;
+                    header.Serialize(stream);
+                }
+
+                if(ftruncate(fd, 0) != 0)
+                    throw std::runtime_error("Cannot truncate " + journalName);
+                end = 0;
+                append(bytes, true);
+            }
+
+            /* Throws if the journal was written for another mesh */
+            void validate()
+            {
+                char data[HEADER_SIZE];
+                if(pread(fd, data, HEADER_SIZE, 0) !=
+                   static_cast<ssize_t>(HEADER_SIZE)
+                || LoadLittleEndian<uint32_t>(data) != MAGIC)
+                    throw std::runtime_error(journalName
+                                             + " is not a journal");
+
+                VoronoiWorldHeader stored;
+                stored.Parse(data + 4, HEADER_SIZE - 4);
+                if(!stored.SameWorld(header))
+                    throw std::runtime_error(journalName
+                                             + " belongs to another mesh");
+
+                // Existing records are encoded with the stored flags
+                header.flags = stored.flags;
+            }
+
+            void append(const std::vector<char> &bytes, bool sync)
+            {
+                const char *data = bytes.data();
+                size_t left = bytes.size();
+                while(left > 0)
+                {
+                    ssize_t n = pwrite(fd, data, left, end);
+                    if(n <= 0)
+                        throw std::runtime_error("Cannot write "
+                                                 + journalName);
+                    data += n;
+                    left -= n;
+                    end += n;
+                }
+                if(sync && fsync(fd) != 0)
+                    throw std::runtime_error("Cannot sync " + journalName);
+            }
+
+            static void syncFile(const std::string &filename)
+            {
+                int fileFd = open(filename.c_str(), O_RDONLY);
+                if(fileFd < 0 || fsync(fileFd) != 0)
+                {
+                    if(fileFd >= 0)
+                        close(fileFd);
+                    throw std::runtime_error("Cannot sync " + filename);
+                }
+                close(fileFd);
+            }
+
+            static std::string directoryOf(const std::string &filename)
+            {
+                size_t slash = filename.rfind('/');
+                if(slash == std::string::npos)
+                    return ".";
+                return slash == 0 ? "/" : filename.substr(0, slash);
+            }
+
+            void addRecord(VoronoiWorldWriter<T, P> &writer,
+                           const MappedFile &journal,
+                           const std::pair<const TileCoord<2>,
+                                           std::pair<uint64_t, uint64_t>>
+                               &record)
+            {
+                writer.AddPayload(record.first.coord,
+                                  journal.Data() + record.second.first,
+                                  record.second.second);
+            }
+
+            /* Calls f(coord, payload, length) on every valid record, in
+             * order, until f returns false. Returns the end offset of the
+             * last valid record. */
+            template<typename F>
+            uint64_t forEachRecord(F f)
+            {
+                MappedFile journal(journalName);
+                const char *data = journal.Data();
+                uint64_t size = journal.Size();
+                if(size < HEADER_SIZE || LoadLittleEndian<uint32_t>(data)
+                                         != MAGIC)
+                    throw std::runtime_error(journalName
+                                             + " is not a journal");
+
+                recordOffset = HEADER_SIZE;
+                while(size - recordOffset >= RECORD_HEADER_SIZE)
+                {
+                    const char *record = data + recordOffset;
+                    if(LoadLittleEndian<uint32_t>(record) != RECORD_MAGIC)
+                        break;
+
+                    uint64_t length = LoadLittleEndian<uint32_t>(record + 4);
+                    if(length > size - recordOffset - RECORD_HEADER_SIZE)
+                        break;
+
+                    const char *payload = record + RECORD_HEADER_SIZE;
+                    uint32_t crc = Crc32(record + 8, 8);
+                    crc = Crc32(payload, length, crc);
+                    if(crc != LoadLittleEndian<uint32_t>(record + 16))
+                        break;
+
+                    std::array<int, 2> coord = {{
+                        LoadLittleEndian<int32_t>(record + 8),
+                        LoadLittleEndian<int32_t>(record + 12)}};
+                    if(!f(coord, payload, length))
+                        break;
+
+                    recordOffset += RECORD_HEADER_SIZE + length;
+                }
+                return recordOffset;
+            }
+
+            std::string journalName;
+            std::string baseName;
+            VoronoiWorldHeader header;
+            int fd;
+            uint64_t end;
+            uint64_t recordOffset;
+    };
+}
+
+#endif
+
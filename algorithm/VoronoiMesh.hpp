@@ -6,33 +6,48 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <cstdint>
+#include <mutex>
 
 #include "VoronoiUtils.hpp"
 #include "../core/Incrementable.hpp"
+#include "../core/ThreadPool.hpp"
+#include "../random/SeededNumberGenerator.hpp"
 
 namespace pg
 {
-    template<typename T, typename P>
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>>
     class VoronoiMesh : public pg::Serializable,
-                        public pg::Incrementable<pg::VoronoiTile<T, P>, 2>
+                        public pg::Incrementable<
+                            pg::VoronoiTile<T, P, Metric>, 2>
     {
         public:
             VoronoiMesh(pg::NumberGenerator &ngenerator,
                         PropertyGenerator<T, P> &pgenerator):
-                pg::Incrementable<pg::VoronoiTile<T, P>, 2>(ngenerator),
-                propertyGenerator(pgenerator)
+                pg::Incrementable<pg::VoronoiTile<T, P, Metric>, 2>(
+                    ngenerator),
+                propertyGenerator(pgenerator),
+                seed(ngenerator()),
+                relaxationIterations(0),
+                relaxationSamples(0),
+                trackDirty(false)
             {
             }
 
             VoronoiMesh(pg::NumberGenerator &ngenerator,
                         PropertyGenerator<T, P> &pgenerator,
                         size_t tDensityX, size_t tDensityY, T uX, T uY):
-                pg::Incrementable<pg::VoronoiTile<T, P>, 2>(ngenerator),
+                pg::Incrementable<pg::VoronoiTile<T, P, Metric>, 2>(
+                    ngenerator),
                 propertyGenerator(pgenerator),
                 tileDensityX(tDensityX),
                 tileDensityY(tDensityY),
                 unitX(uX),
-                unitY(uY)
+                unitY(uY),
+                seed(ngenerator()),
+                relaxationIterations(0),
+                relaxationSamples(0),
+                trackDirty(false)
             {
             }
 
@@ -44,7 +59,7 @@ namespace pg
                 struct Candidate
                 {
                     VoronoiSite<T, P> *site;
-                    float distance;
+                    T distance;
 
                     bool operator<(const Candidate &a)
                     {
@@ -54,17 +69,17 @@ namespace pg
 
                 int tileX = std::floor(point.x / unitX);
                 int tileY = std::floor(point.y / unitY);
-                VoronoiTile<T, P> &tile = this->At({tileX, tileY});
+                VoronoiTile<T, P, Metric> &tile = this->At({tileX, tileY});
 
                 size_t subtileIndex;
-                float distance;
+                T distance;
                 VoronoiSite<T, P> &site = tile.SiteAt(point, subtileIndex,
                                                       distance);
 
                 size_t subtileX = subtileIndex % tileDensityX;
                 size_t subtileY = subtileIndex / tileDensityX;
 
-                std::vector<VoronoiTile<T, P>*> borderTiles;
+                std::vector<VoronoiTile<T, P, Metric>*> borderTiles;
                 std::vector<Candidate> candidates = {{&site, distance}};
 
                 if(subtileX == 0) // Left border
@@ -92,7 +107,7 @@ namespace pg
                 for(auto borderTile : borderTiles)
                 {
                     size_t subtileIndex;
-                    float distance;
+                    T distance;
                     VoronoiSite<T, P> &site =
                         borderTile->SiteAt(point, subtileIndex, distance);
                     candidates.push_back({&site, distance});
@@ -104,7 +119,300 @@ namespace pg
 
                 return *candidates[0].site;
             }
+
+            /* Same as SiteAt() without generating anything, so that it can
+             * be called concurrently with other const methods. Returns
+             * nullptr if a tile SiteAt() would look at is missing. */
+            const VoronoiSite<T, P> *FindSiteAt(const VPoint<T> &point) const
+            {
+                int tileX = std::floor(point.x / unitX);
+                int tileY = std::floor(point.y / unitY);
+                const VoronoiTile<T, P, Metric> *tile = findTile({{tileX,
+                                                                   tileY}});
+                if(tile == nullptr)
+                    return nullptr;
+
+                size_t subtileIndex;
+                T distance;
+                const VoronoiSite<T, P> *site =
+                    &tile->SiteAt(point, subtileIndex, distance);
+
+                size_t subtileX = subtileIndex % tileDensityX;
+                size_t subtileY = subtileIndex / tileDensityX;
+
+                std::array<int, 2> borderTiles[2];
+                size_t borderCount = 0;
+                if(subtileX == 0) // Left border
+                    borderTiles[borderCount++] = {{tileX-1, tileY}};
+                else if(subtileX + 1 == tileDensityX) // Right border
+                    borderTiles[borderCount++] = {{tileX+1, tileY}};
+
+                if(subtileY == 0) // Upper border
+                    borderTiles[borderCount++] = {{tileX, tileY-1}};
+                else if(subtileY + 1 == tileDensityY) // Lower border
+                    borderTiles[borderCount++] = {{tileX, tileY+1}};
+
+                for(size_t i = 0; i < borderCount; ++i)
+                {
+                    tile = findTile(borderTiles[i]);
+                    if(tile == nullptr)
+                        return nullptr;
+
+                    T borderDistance;
+                    const VoronoiSite<T, P> &borderSite =
+                        tile->SiteAt(point, subtileIndex, borderDistance);
+                    if(borderDistance < distance)
+                    {
+                        distance = borderDistance;
+                        site = &borderSite;
+                    }
+                }
+
+                return site;
+            }
+
+            /* Geometric queries on site positions, independent from Metric.
+             * They rely on every site lying inside its own sub-cell so only
+             * the sub-cells overlapping the query are visited. Results are
+             * written into the caller's buffer, which is cleared first, and
+             * the number of sites found is returned. */
+
+            /* Sites sorted by increasing distance to point */
+            size_t KNearest(const VPoint<T> &point, size_t k,
+                            std::vector<VoronoiSite<T, P>*> &sites)
+            {
+                sites.clear();
+                if(k == 0)
+                    return 0;
+
+                auto closer = [&point](const VoronoiSite<T, P> *a,
+                                       const VoronoiSite<T, P> *b)
+                {
+                    return dist2(point, a->point) < dist2(point, b->point);
+                };
+
+                T paceX = unitX / tileDensityX;
+                T paceY = unitY / tileDensityY;
+                long cellX = std::floor(point.x / paceX);
+                long cellY = std::floor(point.y / paceY);
+
+                // Max-heap on the distance, visiting rings of sub-cells
+                // around the one containing the point
+                for(long ring = 0; ; ++ring)
+                {
+                    for(long y = cellY - ring; y <= cellY + ring; ++y)
+                    {
+                        bool borderRow = (y == cellY - ring
+                                       || y == cellY + ring);
+                        long step = borderRow ? 1 : 2 * ring;
+                        for(long x = cellX - ring; x <= cellX + ring;
+                            x += step)
+                        {
+                            VoronoiSite<T, P> *site = &siteOfCell(x, y);
+                            if(sites.size() < k)
+                            {
+                                sites.push_back(site);
+                                std::push_heap(sites.begin(), sites.end(),
+                                               closer);
+                            }
+                            else if(closer(site, sites.front()))
+                            {
+                                std::pop_heap(sites.begin(), sites.end(),
+                                              closer);
+                                sites.back() = site;
+                                std::push_heap(sites.begin(), sites.end(),
+                                               closer);
+                            }
+                        }
+                    }
+
+                    if(sites.size() < k)
+                        continue;
+
+                    // Any site in the next ring is at least that far
+                    T bound = std::min(
+                        std::min(point.x - (cellX - ring) * paceX,
+                                 (cellX + ring + 1) * paceX - point.x),
+                        std::min(point.y - (cellY - ring) * paceY,
+                                 (cellY + ring + 1) * paceY - point.y));
+                    if(dist2(point, sites.front()->point) <= bound * bound)
+                        break;
+                }
+
+                std::sort_heap(sites.begin(), sites.end(), closer);
+                return sites.size();
+            }
+
+            /* Sites such that minPoint <= site.point <= maxPoint */
+            size_t SitesInRect(const VPoint<T> &minPoint,
+                               const VPoint<T> &maxPoint,
+                               std::vector<VoronoiSite<T, P>*> &sites)
+            {
+                sites.clear();
+                forEachSiteInRect(minPoint, maxPoint,
+                    [&](VoronoiSite<T, P> &site)
+                    {
+                        if(site.point.x >= minPoint.x
+                        && site.point.x <= maxPoint.x
+                        && site.point.y >= minPoint.y
+                        && site.point.y <= maxPoint.y)
+                            sites.push_back(&site);
+                    });
+                return sites.size();
+            }
+
+            size_t SitesInRadius(const VPoint<T> &center, T radius,
+                                 std::vector<VoronoiSite<T, P>*> &sites)
+            {
+                sites.clear();
+                T radius2 = radius * radius;
+                forEachSiteInRect({center.x - radius, center.y - radius},
+                                  {center.x + radius, center.y + radius},
+                    [&](VoronoiSite<T, P> &site)
+                    {
+                        if(dist2(center, site.point) <= radius2)
+                            sites.push_back(&site);
+                    });
+                return sites.size();
+            }
             
+            /* Generates every missing tile of [minCoord, maxCoord] on the
+             * pool and inserts them all at once, after loading the ones
+             * loadTile() knows of. Property generator calls are serialized
+             * unless it is thread-safe. */
+            void GenerateRegion(const std::array<int, 2> &minCoord,
+                                const std::array<int, 2> &maxCoord,
+                                pg::ThreadPool &pool)
+            {
+                std::vector<std::array<int, 2>> coords;
+                for(int y = minCoord[1]; y <= maxCoord[1]; ++y)
+                    for(int x = minCoord[0]; x <= maxCoord[0]; ++x)
+                    {
+                        if(this->tiles.find({{x, y}}) == this->tiles.end()
+                        && !loadTile({{x, y}}))
+                            coords.push_back({{x, y}});
+                    }
+
+                std::mutex propertyMutex;
+                std::mutex *mutex = propertyGenerator.ThreadSafe()
+                                  ? nullptr : &propertyMutex;
+                std::vector<VoronoiTile<T, P, Metric>> generated(
+                    coords.size());
+                pg::ParallelFor(pool, coords.size(), [&](size_t i)
+                {
+                    generated[i] = generateTile(coords[i], mutex);
+                });
+
+                for(size_t i = 0; i < coords.size(); ++i)
+                    this->tiles.insert({coords[i], std::move(generated[i])});
+                if(trackDirty)
+                    dirtyTiles.insert(dirtyTiles.end(), coords.begin(),
+                                      coords.end());
+            }
+
+            void GenerateRegion(const std::array<int, 2> &minCoord,
+                                const std::array<int, 2> &maxCoord)
+            {
+                pg::ThreadPool pool;
+                GenerateRegion(minCoord, maxCoord, pool);
+            }
+
+            /* Lloyd relaxation of newly generated tiles. Centroids are
+             * accumulated over a raster of samplesPerCell^2 samples per
+             * sub-cell spanning the tile and its 8 neighbours, which only
+             * depends on the seed so relaxed tiles do not depend on the
+             * generation order either. Relaxed sites are kept inside their
+             * own sub-cell. 0 iterations disables the relaxation. */
+            void SetRelaxation(size_t iterations, size_t samplesPerCell = 4)
+            {
+                relaxationIterations = iterations;
+                relaxationSamples = std::max<size_t>(samplesPerCell, 1);
+            }
+
+            size_t RelaxationIterations() const
+            {
+                return relaxationIterations;
+            }
+
+            size_t RelaxationSamples() const
+            {
+                return relaxationSamples;
+            }
+
+            size_t TileDensityX() const
+            {
+                return tileDensityX;
+            }
+
+            size_t TileDensityY() const
+            {
+                return tileDensityY;
+            }
+
+            T UnitX() const
+            {
+                return unitX;
+            }
+
+            T UnitY() const
+            {
+                return unitY;
+            }
+
+            /* Tile positions only depend on the seed and on their
+             * coordinates, whatever the generation order */
+            unsigned int Seed() const
+            {
+                return seed;
+            }
+
+            void SetSeed(unsigned int s)
+            {
+                seed = s;
+            }
+
+            /* Stores tile at coord, replacing any existing one, without
+             * marking it as dirty */
+            VoronoiTile<T, P, Metric> &InsertTile(
+                const std::array<int, 2> &coord,
+                const VoronoiTile<T, P, Metric> &tile)
+            {
+                VoronoiTile<T, P, Metric> &stored = this->tiles[coord];
+                stored = tile;
+                return stored;
+            }
+
+            /* Starts keeping track of dirty tiles, which nothing else
+             * would take: tiles generated from then on and until the next
+             * call to TakeDirtyTiles() are dirty. Tiles modified through
+             * At() must be marked by hand. */
+            void EnableDirtyTracking()
+            {
+                trackDirty = true;
+            }
+
+            void MarkDirty(const std::array<int, 2> &coord)
+            {
+                if(trackDirty)
+                    dirtyTiles.push_back(coord);
+            }
+
+            /* Moves the dirty tile coordinates to coords, possibly with
+             * duplicates, and clears them */
+            void TakeDirtyTiles(std::vector<std::array<int, 2>> &coords)
+            {
+                coords.clear();
+                coords.swap(dirtyTiles);
+            }
+
+            /* Generates the tile at coord the same way At() would, without
+             * storing it in the mesh */
+            VoronoiTile<T, P, Metric> GenerateTile(
+                const std::array<int, 2> &coord)
+            {
+                return generateTile(coord, nullptr);
+            }
+
             pg::InputStream &Deserialize(pg::InputStream &stream)
             {
                 size_t size;
@@ -115,7 +423,7 @@ namespace pg
                 for(size_t i = 0; i < size; ++i)
                 {
                     pg::TileCoord<2> key;
-                    VoronoiTile<T, P> value;
+                    VoronoiTile<T, P, Metric> value;
 
                     stream >> key >> value;
                     this->tiles.insert({key, value});
@@ -128,31 +436,251 @@ namespace pg
                 stream << tileDensityX << tileDensityY << unitX << unitY
                        << this->tiles.size();
                 
-                for(auto tile : this->tiles)
+                for(const auto &tile : this->tiles)
                     stream << tile.first << tile.second;
                 return stream;
             }
 
         protected:
-            VoronoiTile<T, P> &increment(const std::array<int, 2> &coord)
+            static long floorDiv(long a, long b)
+            {
+                return a >= 0 ? a / b : -((-a + b - 1) / b);
+            }
+
+            const VoronoiTile<T, P, Metric> *findTile(
+                const std::array<int, 2> &coord) const
+            {
+                auto it = this->tiles.find(coord);
+                return it != this->tiles.end() ? &it->second : nullptr;
+            }
+
+            /* Site of the sub-cell (x, y), in sub-cell units */
+            VoronoiSite<T, P> &siteOfCell(long x, long y)
+            {
+                long densityX = tileDensityX;
+                long densityY = tileDensityY;
+                long tileX = floorDiv(x, densityX);
+                long tileY = floorDiv(y, densityY);
+                long subtileX = x - tileX * densityX;
+                long subtileY = y - tileY * densityY;
+
+                VoronoiTile<T, P, Metric> &tile =
+                    this->At({static_cast<int>(tileX),
+                              static_cast<int>(tileY)});
+                return tile.Sites()[subtileX + subtileY * densityX];
+            }
+
+            /* Calls f on the site of every sub-cell overlapping the
+             * rectangle, one tile lookup per overlapping tile */
+            template<typename F>
+            void forEachSiteInRect(const VPoint<T> &minPoint,
+                                   const VPoint<T> &maxPoint, F f)
+            {
+                long densityX = tileDensityX;
+                long densityY = tileDensityY;
+                long minX = std::floor(minPoint.x * densityX / unitX);
+                long maxX = std::floor(maxPoint.x * densityX / unitX);
+                long minY = std::floor(minPoint.y * densityY / unitY);
+                long maxY = std::floor(maxPoint.y * densityY / unitY);
+
+                for(long tileY = floorDiv(minY, densityY);
+                    tileY <= floorDiv(maxY, densityY); ++tileY)
+                    for(long tileX = floorDiv(minX, densityX);
+                        tileX <= floorDiv(maxX, densityX); ++tileX)
+                    {
+                        VoronoiTile<T, P, Metric> &tile =
+                            this->At({static_cast<int>(tileX),
+                                      static_cast<int>(tileY)});
+
+                        long x0 = std::max(minX - tileX * densityX, 0L);
+                        long x1 = std::min(maxX - tileX * densityX,
+                                           densityX - 1);
+                        long y0 = std::max(minY - tileY * densityY, 0L);
+                        long y1 = std::min(maxY - tileY * densityY,
+                                           densityY - 1);
+                        for(long y = y0; y <= y1; ++y)
+                            for(long x = x0; x <= x1; ++x)
+                                f(tile.Sites()[x + y * densityX]);
+                    }
+            }
+
+            /* Inserts the tile at coord from elsewhere than the property
+             * generator, e.g. a file, and returns true if there is one */
+            virtual bool loadTile(const std::array<int, 2> &)
+            {
+                return false;
+            }
+
+            VoronoiTile<T, P, Metric> &increment(
+                const std::array<int, 2> &coord)
+            {
+                auto itInsert = this->tiles.insert(
+                    {coord, generateTile(coord, nullptr)});
+                if(!itInsert.second){} // TODO
+                MarkDirty(coord);
+                return itInsert.first->second;
+            }
+
+            unsigned int tileSeed(const std::array<int, 2> &coord) const
+            {
+                return pg::CoordSeed(seed, coord);
+            }
+
+            void jitteredPoints(const std::array<int, 2> &coord,
+                                std::vector<pg::MapPoint<T>> &points) const
             {
                 int x = coord[0];
                 int y = coord[1];
 
-                std::vector<pg::MapPoint<T>> points;
-                pg::CreateRandomizedGrid(this->rngenerator, points, x*unitX,
+                pg::SeededNumberGenerator tileGenerator(tileSeed(coord));
+                pg::CreateRandomizedGrid(tileGenerator, points, x*unitX,
                                          (x+1)*unitX, y*unitY, (y+1)*unitY,
                                          tileDensityX, tileDensityY);
+            }
+
+            /* Relaxes the jittered points of the 3x3 tiles around coord as
+             * a whole and keeps the ones of the central tile */
+            void relaxedPoints(const std::array<int, 2> &coord,
+                               std::vector<pg::MapPoint<T>> &points) const
+            {
+                const long BLOCK = 3;
+                long densityX = tileDensityX;
+                long densityY = tileDensityY;
+                long width = BLOCK * densityX;
+                long height = BLOCK * densityY;
+                T paceX = unitX / densityX;
+                T paceY = unitY / densityY;
+                T originX = (coord[0] - 1) * unitX;
+                T originY = (coord[1] - 1) * unitY;
+
+                // Cells are stored row by row over the whole block
+                std::vector<pg::MapPoint<T>> block(width * height);
+                std::vector<pg::MapPoint<T>> tilePoints;
+                for(long tileY = 0; tileY < BLOCK; ++tileY)
+                    for(long tileX = 0; tileX < BLOCK; ++tileX)
+                    {
+                        jitteredPoints({{coord[0] + int(tileX) - 1,
+                                         coord[1] + int(tileY) - 1}},
+                                       tilePoints);
+                        for(long y = 0; y < densityY; ++y)
+                            for(long x = 0; x < densityX; ++x)
+                            {
+                                block[tileX * densityX + x
+                                    + (tileY * densityY + y) * width] =
+                                    tilePoints[x + y * densityX];
+                            }
+                    }
+
+                // The own site of a sample is at most one cell diagonal
+                // away, which bounds how many cells may hold a closer one
+                T diagonal = std::sqrt(paceX * paceX + paceY * paceY);
+                long rangeX = std::floor(diagonal / paceX) + 1;
+                long rangeY = std::floor(diagonal / paceY) + 1;
+
+                long samples = relaxationSamples;
+                std::vector<T> sumX(block.size());
+                std::vector<T> sumY(block.size());
+                std::vector<size_t> count(block.size());
+                for(size_t iteration = 0; iteration < relaxationIterations;
+                    ++iteration)
+                {
+                    std::fill(sumX.begin(), sumX.end(), 0);
+                    std::fill(sumY.begin(), sumY.end(), 0);
+                    std::fill(count.begin(), count.end(), 0);
+
+                    for(long sy = 0; sy < height * samples; ++sy)
+                        for(long sx = 0; sx < width * samples; ++sx)
+                        {
+                            pg::MapPoint<T> sample(
+                                originX + paceX * (sx + T(.5)) / samples,
+                                originY + paceY * (sy + T(.5)) / samples);
+                            long cellX = sx / samples;
+                            long cellY = sy / samples;
+
+                            size_t nearest = cellX + cellY * width;
+                            T minDistance = dist2(sample, block[nearest]);
+                            for(long y = std::max(cellY - rangeY, 0L);
+                                y <= std::min(cellY + rangeY, height - 1);
+                                ++y)
+                                for(long x = std::max(cellX - rangeX, 0L);
+                                    x <= std::min(cellX + rangeX, width - 1);
+                                    ++x)
+                                {
+                                    T d = dist2(sample, block[x + y * width]);
+                                    if(d < minDistance)
+                                    {
+                                        minDistance = d;
+                                        nearest = x + y * width;
+                                    }
+                                }
+
+                            sumX[nearest] += sample.x;
+                            sumY[nearest] += sample.y;
+                            ++count[nearest];
+                        }
+
+                    for(long y = 0; y < height; ++y)
+                        for(long x = 0; x < width; ++x)
+                        {
+                            size_t i = x + y * width;
+                            if(count[i] == 0)
+                                continue;
+
+                            T minX = originX + paceX * x;
+                            T minY = originY + paceY * y;
+                            block[i].x = clampToCell(sumX[i] / count[i],
+                                                     minX, minX + paceX);
+                            block[i].y = clampToCell(sumY[i] / count[i],
+                                                     minY, minY + paceY);
+                        }
+                }
+
+                points.resize(densityX * densityY);
+                for(long y = 0; y < densityY; ++y)
+                    for(long x = 0; x < densityX; ++x)
+                    {
+                        points[x + y * densityX] =
+                            block[densityX + x + (densityY + y) * width];
+                    }
+            }
+
+            /* Clamps strictly inside [min, max], with a small margin so that
+             * rounding cannot move the value into a neighbouring cell */
+            static T clampToCell(T value, T min, T max)
+            {
+                T margin = (max - min) / 1024;
+                return std::max(min + margin, std::min(value, max - margin));
+            }
+
+            /* Does not touch the mesh, so it can run concurrently as long
+             * as propertyGenerator calls are guarded by propertyMutex when
+             * it is not null */
+            VoronoiTile<T, P, Metric> generateTile(
+                const std::array<int, 2> &coord, std::mutex *propertyMutex)
+            {
+                std::vector<pg::MapPoint<T>> points;
+                if(relaxationIterations == 0)
+                    jitteredPoints(coord, points);
+                else
+                    relaxedPoints(coord, points);
+
                 std::vector<VoronoiSite<T, P>> sites(points.size());
                 for(size_t i = 0; i < sites.size(); ++i)
-                {
                     sites[i].point = points[i];
-                    sites[i].properties = propertyGenerator(points[i]);
+
+                if(propertyMutex != nullptr)
+                {
+                    std::lock_guard<std::mutex> lock(*propertyMutex);
+                    for(auto &site : sites)
+                        site.properties = propertyGenerator(site.point);
+                }
+                else
+                {
+                    for(auto &site : sites)
+                        site.properties = propertyGenerator(site.point);
                 }
 
-                auto itInsert = this->tiles.insert({coord, VoronoiTile<T, P>(sites)});
-                if(!itInsert.second){} // TODO
-                return itInsert.first->second;
+                return VoronoiTile<T, P, Metric>(sites);
             }
 
             PropertyGenerator<T, P> &propertyGenerator;
@@ -160,6 +688,11 @@ namespace pg
             size_t tileDensityY;
             T unitX;
             T unitY;
+            unsigned int seed;
+            size_t relaxationIterations;
+            size_t relaxationSamples;
+            bool trackDirty;
+            std::vector<std::array<int, 2>> dirtyTiles;
     };
 }
 
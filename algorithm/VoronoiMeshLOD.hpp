@@ -0,0 +1,165 @@
+#ifndef VORONOI_MESH_LOD_HPP
+#define VORONOI_MESH_LOD_HPP
+
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "VoronoiMesh.hpp"
+#include "SiteGraph.hpp"
+
+namespace pg
+{
+    /* Most common of the properties of 4 sites, the first one on ties so
+     * that repeated reductions do not drift towards any value. P must be
+     * comparable with ==. */
+    template<typename P>
+    struct MajorityReducer
+    {
+        P operator()(const P (&properties)[4]) const
+        {
+            size_t best = 0;
+            size_t bestCount = 0;
+            for(size_t i = 0; i < 4; ++i)
+            {
+                size_t count = std::count(properties, properties + 4,
+                                          properties[i]);
+                if(count > bestCount)
+                {
+                    best = i;
+                    bestCount = count;
+                }
+            }
+            return properties[best];
+        }
+    };
+
+    /* Properties of the sites of a level of a VoronoiMeshLOD, reduced from
+     * the 4 sites of the finer level whose sub-cells make up the sub-cell
+     * of the site. Finer tiles are generated as needed. */
+    template<typename T, typename P, typename Metric, typename Reduce>
+    class AggregatedProperties : public PropertyGenerator<T, P>
+    {
+        public:
+            AggregatedProperties(VoronoiMesh<T, P, Metric> &finerMesh):
+                graph(finerMesh)
+            {
+            }
+
+            virtual ~AggregatedProperties() = default;
+
+            virtual P operator()(const VPoint<T> &point)
+            {
+                // Coarse sub-cells are twice as large as finer ones
+                typename SiteGraph<T, P, Metric>::Cell cell =
+                    graph.CellOf(point);
+                long x = (cell[0] >= 0 ? cell[0] : cell[0] - 1) / 2 * 2;
+                long y = (cell[1] >= 0 ? cell[1] : cell[1] - 1) / 2 * 2;
+
+                P properties[4];
+                for(size_t i = 0; i < 4; ++i)
+                {
+                    properties[i] = graph.Site({{x + long(i % 2),
+                                                 y + long(i / 2)}})
+                                    .properties;
+                }
+                return Reduce()(properties);
+            }
+
+        protected:
+            SiteGraph<T, P, Metric> graph;
+    };
+
+    /* Stack of VoronoiMesh levels for zoomed out views. Level l has tiles
+     * 2^l times wider and taller than level 0 with the same site density,
+     * hence 4^l times fewer sites over the same area. Level 0 draws its
+     * properties from the PropertyGenerator, every other level reduces
+     * each site's from the 4 sites of the level below covering its
+     * sub-cell, majority vote by default, so coarse levels show the
+     * content of level 0 rather than samples of the generator at a few
+     * points. With a majority vote, features smaller than a coarse
+     * sub-cell are dropped, and the remaining ones are kept where level 0
+     * has them.
+     *
+     * Lookups at a large footprint touch 4^l times fewer sites, but
+     * generating a coarse tile generates the finer tiles under it, down to
+     * level 0, so the first view of an area costs as much as at level 0.
+     * examples/lodSample.cpp measures how far each level departs from
+     * level 0. */
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>,
+             typename Reduce = MajorityReducer<P>>
+    class VoronoiMeshLOD
+    {
+        public:
+            VoronoiMeshLOD(pg::NumberGenerator &ngenerator,
+                           PropertyGenerator<T, P> &pgenerator,
+                           size_t tDensityX, size_t tDensityY, T uX, T uY,
+                           size_t levelCount):
+                cellSize(std::min(uX / tDensityX, uY / tDensityY))
+            {
+                if(levelCount == 0)
+                {
+                    throw std::runtime_error("VoronoiMeshLOD should have at "
+                                             "least one level");
+                }
+
+                levels.resize(levelCount);
+                T scale = 1;
+                for(size_t l = 0; l < levelCount; ++l)
+                {
+                    PropertyGenerator<T, P> *properties = &pgenerator;
+                    if(l > 0)
+                    {
+                        aggregators.emplace_back(new Aggregator(
+                            *levels[l - 1]));
+                        properties = aggregators.back().get();
+                    }
+
+                    levels[l].reset(new VoronoiMesh<T, P, Metric>(ngenerator,
+                        *properties, tDensityX, tDensityY, uX * scale,
+                        uY * scale));
+                    scale *= 2;
+                }
+            }
+
+            virtual ~VoronoiMeshLOD() = default;
+
+            size_t LevelCount() const
+            {
+                return levels.size();
+            }
+
+            VoronoiMesh<T, P, Metric> &Level(size_t level)
+            {
+                return *levels[level];
+            }
+
+            /* Coarsest level whose sub-cells are not larger than footprint,
+             * the size of the area covered by one sample (e.g. a pixel) */
+            size_t LevelFor(T footprint) const
+            {
+                if(!(footprint > cellSize))
+                    return 0;
+
+                size_t level = std::floor(std::log2(footprint / cellSize));
+                return std::min(level, levels.size() - 1);
+            }
+
+            VoronoiSite<T, P> &SiteAt(const VPoint<T> &point, T footprint)
+            {
+                return levels[LevelFor(footprint)]->SiteAt(point);
+            }
+
+        protected:
+            typedef AggregatedProperties<T, P, Metric, Reduce> Aggregator;
+
+            // Before levels, whose meshes refer to them
+            std::vector<std::unique_ptr<Aggregator>> aggregators;
+            std::vector<std::unique_ptr<VoronoiMesh<T, P, Metric>>> levels;
+            T cellSize;
+    };
+}
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef VORONOI_SNAPSHOT_HPP
+#define VORONOI_SNAPSHOT_HPP
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "VoronoiMesh.hpp"
+#include "../core/MappedFile.hpp"
+#include "../core/Serializable.hpp"
+
+namespace pg
+{
+    /* Snapshot layout, in the native byte order and struct layout of the
+     * host, so that it is only portable between identical builds:
+     *   header     VoronoiSnapshotHeader
+     *   directory  tileCount VoronoiSnapshotEntry sorted by (x, y)
+     *   sites      siteCount VoronoiSite<T, P>, starting at sitesOffset
+     * Only offsets are stored, so the file can be mapped at any address
+     * and used in place. */
+    struct VoronoiSnapshotHeader
+    {
+        static const uint32_t MAGIC = 0x53564750; // "PGVS"
+        static const uint32_t VERSION = 1;
+        static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+        static const uint64_t SITES_ALIGNMENT = 64;
+
+        uint32_t magic;
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t scalarSize;
+        uint32_t siteSize;
+        uint32_t siteAlignment;
+        uint64_t tileDensityX;
+        uint64_t tileDensityY;
+        double unitX;
+        double unitY;
+        uint32_t seed;
+        uint32_t reserved;
+        uint64_t tileCount;
+        uint64_t directoryOffset;
+        uint64_t sitesOffset;
+        uint64_t siteCount;
+    };
+
+    struct VoronoiSnapshotEntry
+    {
+        int32_t x;
+        int32_t y;
+        uint32_t siteCount;
+        uint32_t reserved;
+        uint64_t firstSite;
+
+        bool operator<(const VoronoiSnapshotEntry &b) const
+        {
+            return x < b.x
+                || (x == b.x && y < b.y);
+        }
+    };
+
+    /* Writes the tiles generated so far by mesh. The file is written aside
+     * and renamed, so processes mapping a previous snapshot keep it. */
+    template<typename T, typename P, typename Metric>
+    void SaveVoronoiSnapshot(const VoronoiMesh<T, P, Metric> &mesh,
+                             const std::string &filename)
+    {
+        typedef VoronoiSite<T, P> Site;
+        static_assert(std::is_trivially_copyable<Site>::value,
+                      "Snapshot sites are copied as raw memory");
+
+        VoronoiSnapshotHeader header = VoronoiSnapshotHeader();
+        header.magic = VoronoiSnapshotHeader::MAGIC;
+        header.version = VoronoiSnapshotHeader::VERSION;
+        header.byteOrder = VoronoiSnapshotHeader::BYTE_ORDER_MARK;
+        header.scalarSize = sizeof(T);
+        header.siteSize = sizeof(Site);
+        header.siteAlignment = alignof(Site);
+        header.tileDensityX = mesh.TileDensityX();
+        header.tileDensityY = mesh.TileDensityY();
+        header.unitX = mesh.UnitX();
+        header.unitY = mesh.UnitY();
+        header.seed = mesh.Seed();
+
+        // Tiles are already sorted by coordinates
+        std::vector<VoronoiSnapshotEntry> directory;
+        for(const auto &tile : mesh.Tiles())
+        {
+            VoronoiSnapshotEntry entry = VoronoiSnapshotEntry();
+            entry.x = tile.first.coord[0];
+            entry.y = tile.first.coord[1];
+            entry.siteCount = tile.second.Sites().size();
+            entry.firstSite = header.siteCount;
+            header.siteCount += entry.siteCount;
+            directory.push_back(entry);
+        }
+
+        const uint64_t ALIGNMENT = VoronoiSnapshotHeader::SITES_ALIGNMENT;
+        header.tileCount = directory.size();
+        header.directoryOffset = sizeof(header);
+        uint64_t directoryEnd = header.directoryOffset
+                              + directory.size() * sizeof(directory[0]);
+        header.sitesOffset = (directoryEnd + ALIGNMENT - 1)
+                           / ALIGNMENT * ALIGNMENT;
+
+        std::string tmpName = filename + ".tmp";
+        int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0)
+            throw std::runtime_error("Cannot open " + tmpName);
+
+        bool good;
+        {
+            FileDescriptorSink sink(fd);
+            pg::OutputStream stream(sink);
+            stream.Write(&header, sizeof(header));
+            stream.Write(directory.data(),
+                         directory.size() * sizeof(directory[0]));
+
+            char padding[VoronoiSnapshotHeader::SITES_ALIGNMENT] = {};
+            stream.Write(padding, header.sitesOffset - directoryEnd);
+            for(const auto &tile : mesh.Tiles())
+            {
+                const auto &sites = tile.second.Sites();
+                stream.Write(sites.data(), sites.size() * sizeof(Site));
+            }
+            stream.Flush();
+            good = stream.Good();
+        }
+        good &= close(fd) == 0;
+
+        if(!good || std::rename(tmpName.c_str(), filename.c_str()) != 0)
+        {
+            std::remove(tmpName.c_str());
+            throw std::runtime_error("Cannot write " + filename);
+        }
+    }
+
+    /* Read-only world mapped from a snapshot file. Sites are used in place,
+     * so every process mapping the same snapshot shares its pages through
+     * the page cache, and opening one costs no deserialization. Tiles
+     * missing from the snapshot are not generated. */
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>>
+    class VoronoiSnapshot
+    {
+        public:
+            typedef VoronoiSite<T, P> Site;
+            static_assert(std::is_trivially_copyable<Site>::value,
+                          "Snapshot sites are used as raw memory");
+
+            VoronoiSnapshot(const std::string &filename):
+                file(filename)
+            {
+                typedef VoronoiSnapshotHeader Header;
+
+                if(file.Size() < sizeof(Header))
+                    throw std::runtime_error("Not a Voronoi snapshot");
+                header = reinterpret_cast<const Header*>(file.Data());
+
+                if(header->magic != Header::MAGIC)
+                    throw std::runtime_error("Not a Voronoi snapshot");
+                if(header->version != Header::VERSION
+                || header->byteOrder != Header::BYTE_ORDER_MARK
+                || header->scalarSize != sizeof(T)
+                || header->siteSize != sizeof(Site)
+                || header->siteAlignment != alignof(Site))
+                    throw std::runtime_error("Voronoi snapshot written by "
+                                             "another build");
+
+                uint64_t size = file.Size();
+                if(header->directoryOffset % alignof(VoronoiSnapshotEntry)
+                || header->directoryOffset > size
+                || header->tileCount > (size - header->directoryOffset)
+                                       / sizeof(VoronoiSnapshotEntry)
+                || header->sitesOffset % alignof(Site)
+                || header->sitesOffset > size
+                || header->siteCount > (size - header->sitesOffset)
+                                       / sizeof(Site))
+                    throw std::runtime_error("Truncated Voronoi snapshot");
+
+                directory = reinterpret_cast<const VoronoiSnapshotEntry*>(
+                    file.Data() + header->directoryOffset);
+                sites = reinterpret_cast<const Site*>(
+                    file.Data() + header->sitesOffset);
+            }
+
+            virtual ~VoronoiSnapshot() = default;
+
+            /* Same result as VoronoiMesh::SiteAt(), except that neighbour
+             * tiles missing from the snapshot are ignored. Throws
+             * std::out_of_range if the tile holding point is missing. */
+            const Site &SiteAt(const VPoint<T> &point) const
+            {
+                int tileX = std::floor(point.x / T(header->unitX));
+                int tileY = std::floor(point.y / T(header->unitY));
+
+                size_t count;
+                const Site *tileSites = TileSites({{tileX, tileY}}, count);
+                if(tileSites == nullptr || count == 0)
+                    throw std::out_of_range("Tile not in Voronoi snapshot");
+
+                size_t subtileIndex;
+                T distance;
+                const Site *site = nearest(tileSites, count, point,
+                                           subtileIndex, distance);
+
+                size_t subtileX = subtileIndex % header->tileDensityX;
+                size_t subtileY = subtileIndex / header->tileDensityX;
+
+                std::array<int, 2> borderTiles[2];
+                size_t borderCount = 0;
+                if(subtileX == 0) // Left border
+                    borderTiles[borderCount++] = {{tileX-1, tileY}};
+                else if(subtileX + 1 == header->tileDensityX) // Right border
+                    borderTiles[borderCount++] = {{tileX+1, tileY}};
+
+                if(subtileY == 0) // Upper border
+                    borderTiles[borderCount++] = {{tileX, tileY-1}};
+                else if(subtileY + 1 == header->tileDensityY) // Lower border
+                    borderTiles[borderCount++] = {{tileX, tileY+1}};
+
+                for(size_t i = 0; i < borderCount; ++i)
+                {
+                    tileSites = TileSites(borderTiles[i], count);
+                    if(tileSites == nullptr || count == 0)
+                        continue;
+
+                    T borderDistance;
+                    const Site *borderSite = nearest(tileSites, count, point,
+                                                     subtileIndex,
+                                                     borderDistance);
+                    if(borderDistance < distance)
+                    {
+                        distance = borderDistance;
+                        site = borderSite;
+                    }
+                }
+
+                return *site;
+            }
+
+            /* Sites of the tile at coord, row by row, or nullptr if the
+             * tile is not in the snapshot */
+            const Site *TileSites(const std::array<int, 2> &coord,
+                                  size_t &count) const
+            {
+                const VoronoiSnapshotEntry *entry = findEntry(coord);
+                if(entry == nullptr || entry->firstSite > header->siteCount
+                || entry->siteCount > header->siteCount - entry->firstSite)
+                {
+                    count = 0;
+                    return nullptr;
+                }
+
+                count = entry->siteCount;
+                return sites + entry->firstSite;
+            }
+
+            size_t TileCount() const
+            {
+                return header->tileCount;
+            }
+
+            size_t TileDensityX() const
+            {
+                return header->tileDensityX;
+            }
+
+            size_t TileDensityY() const
+            {
+                return header->tileDensityY;
+            }
+
+            T UnitX() const
+            {
+                return header->unitX;
+            }
+
+            T UnitY() const
+            {
+                return header->unitY;
+            }
+
+            unsigned int Seed() const
+            {
+                return header->seed;
+            }
+
+        protected:
+            const VoronoiSnapshotEntry *findEntry(
+                const std::array<int, 2> &coord) const
+            {
+                VoronoiSnapshotEntry key = VoronoiSnapshotEntry();
+                key.x = coord[0];
+                key.y = coord[1];
+
+                const VoronoiSnapshotEntry *end = directory
+                                                + header->tileCount;
+                const VoronoiSnapshotEntry *entry =
+                    std::lower_bound(directory, end, key);
+                if(entry == end || key < *entry)
+                    return nullptr;
+                return entry;
+            }
+
+            static const Site *nearest(const Site *tileSites, size_t count,
+                                       const VPoint<T> &point, size_t &index,
+                                       T &distance)
+            {
+                index = 0;
+                distance = Metric::Distance(point, tileSites[0]);
+                for(size_t i = 1; i < count; ++i)
+                {
+                    T tmp = Metric::Distance(point, tileSites[i]);
+                    if(tmp < distance)
+                    {
+                        distance = tmp;
+                        index = i;
+                    }
+                }
+                return tileSites + index;
+            }
+
+            MappedFile file;
+            const VoronoiSnapshotHeader *header;
+            const VoronoiSnapshotEntry *directory;
+            const Site *sites;
+    };
+}
+
+#endif
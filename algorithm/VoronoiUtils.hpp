@@ -6,6 +6,8 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <cmath>
+#include <stdexcept>
 
 #include "../core/Map.hpp"
 #include "../core/Serializable.hpp"
@@ -15,45 +17,29 @@ namespace pg
     template<typename T>
     using VPoint = MapPoint<T>;
     
-    template<typename T>
-    class DistanceModifier
-    {
-        public:
-            DistanceModifier() = default;
-            virtual ~DistanceModifier() = default;
-
-            virtual T operator()(const VPoint<T> &,
-                                 const VPoint<T> &) const
-            {
-                return 0;
-            }
-    
-            static DistanceModifier<T> defaultDistanceModifier;
-    };
-    
-    template<typename T>
-    DistanceModifier<T> DistanceModifier<T>::defaultDistanceModifier;
-
     template<typename T, typename P>
-    struct VoronoiSite : public pg::Serializable
+    struct VoronoiSite
     {
         VPoint<T> point;
         P properties;
+    };
 
-        pg::InputStream &Deserialize(pg::InputStream &stream)
+    template<typename T, typename P>
+    struct Serializer<VoronoiSite<T, P>>
+    {
+        static void Serialize(OutputStream &stream,
+                              const VoronoiSite<T, P> &site)
         {
-            stream >> point.x >> point.y >> properties;
-            return stream;
+            stream << site.point.x << site.point.y << site.properties;
         }
-        
-        pg::OutputStream &Serialize(pg::OutputStream &stream) const
+
+        static void Deserialize(InputStream &stream, VoronoiSite<T, P> &site)
         {
-            stream << point.x << point.y << properties;
-            return stream;
+            stream >> site.point.x >> site.point.y >> site.properties;
         }
     };
 
-    struct VoronoiTileCoord : public pg::Serializable
+    struct VoronoiTileCoord
     {
         int x;
         int y;
@@ -70,22 +56,24 @@ namespace pg
         {
         }
         
-        pg::InputStream &Deserialize(pg::InputStream &stream)
+        bool operator<(const VoronoiTileCoord &b) const
         {
-            stream >> x >> y;
-            return stream;
+            return x < b.x
+                || (x == b.x && y < b.y);
         }
-        
-        pg::OutputStream &Serialize(pg::OutputStream &stream) const
+    };
+
+    template<>
+    struct Serializer<VoronoiTileCoord>
+    {
+        static void Serialize(OutputStream &stream, const VoronoiTileCoord &c)
         {
-            stream << x << y;
-            return stream;
+            stream << c.x << c.y;
         }
-    
-        bool operator<(const VoronoiTileCoord &b) const
+
+        static void Deserialize(InputStream &stream, VoronoiTileCoord &c)
         {
-            return x < b.x
-                || (x == b.x && y < b.y);
+            stream >> c.x >> c.y;
         }
     };
     
@@ -98,6 +86,133 @@ namespace pg
         return dx*dx + dy*dy;
     }
 
+    /* Distance metrics are stateless policies. Distance() only has to be
+     * consistent with itself since it is only ever compared against other
+     * distances computed with the same metric, which is why the Euclidean
+     * metric skips the square root. */
+    template<typename T>
+    struct EuclideanMetric
+    {
+        template<typename P>
+        static inline T Distance(const VPoint<T> &point,
+                                 const VoronoiSite<T, P> &site)
+        {
+            return dist2(point, site.point);
+        }
+    };
+
+    template<typename T>
+    struct ManhattanMetric
+    {
+        template<typename P>
+        static inline T Distance(const VPoint<T> &point,
+                                 const VoronoiSite<T, P> &site)
+        {
+            return std::abs(point.x - site.point.x)
+                 + std::abs(point.y - site.point.y);
+        }
+    };
+
+    template<typename T>
+    struct ChebyshevMetric
+    {
+        template<typename P>
+        static inline T Distance(const VPoint<T> &point,
+                                 const VoronoiSite<T, P> &site)
+        {
+            return std::max(std::abs(point.x - site.point.x),
+                            std::abs(point.y - site.point.y));
+        }
+    };
+
+    /* Whether Metric::Distance() reads the properties of the site, which
+     * the plain distances do not: decoding them can then be skipped */
+    template<typename Metric>
+    struct MetricReadsProperties
+    {
+        static const bool value = true;
+    };
+
+    template<typename T>
+    struct MetricReadsProperties<EuclideanMetric<T>>
+    {
+        static const bool value = false;
+    };
+
+    template<typename T>
+    struct MetricReadsProperties<ManhattanMetric<T>>
+    {
+        static const bool value = false;
+    };
+
+    template<typename T>
+    struct MetricReadsProperties<ChebyshevMetric<T>>
+    {
+        static const bool value = false;
+    };
+
+    /* Default weight accessor of the weighted metrics: reads the weight
+     * member of the site properties */
+    template<typename T>
+    struct PropertyWeight
+    {
+        template<typename P>
+        inline T operator()(const P &properties) const
+        {
+            return properties.weight;
+        }
+    };
+
+    /* Default land accessor of the coastline and distance fields: reads
+     * the island member of the site properties */
+    struct PropertyIsland
+    {
+        template<typename P>
+        inline bool operator()(const P &properties) const
+        {
+            return properties.island;
+        }
+    };
+
+    /* Weighted metrics still rely on the tile border lookup of VoronoiMesh,
+     * so weights should stay small compared to the size of a sub-cell */
+    template<typename T, typename Weight = PropertyWeight<T>>
+    struct AdditivelyWeightedMetric
+    {
+        template<typename P>
+        static inline T Distance(const VPoint<T> &point,
+                                 const VoronoiSite<T, P> &site)
+        {
+            return std::sqrt(dist2(point, site.point))
+                 - Weight()(site.properties);
+        }
+    };
+
+    /* Weights must be strictly positive */
+    template<typename T, typename Weight = PropertyWeight<T>>
+    struct MultiplicativelyWeightedMetric
+    {
+        template<typename P>
+        static inline T Distance(const VPoint<T> &point,
+                                 const VoronoiSite<T, P> &site)
+        {
+            return dist2(point, site.point) / Weight()(site.properties);
+        }
+    };
+
+    /* Power diagram: the weight is the radius of the site */
+    template<typename T, typename Weight = PropertyWeight<T>>
+    struct PowerMetric
+    {
+        template<typename P>
+        static inline T Distance(const VPoint<T> &point,
+                                 const VoronoiSite<T, P> &site)
+        {
+            T radius = Weight()(site.properties);
+            return dist2(point, site.point) - radius * radius;
+        }
+    };
+
     template<typename T, typename P>
     class PropertyGenerator
     {
@@ -106,30 +221,43 @@ namespace pg
             virtual ~PropertyGenerator() = default;
 
             virtual P operator()(const VPoint<T> &point) = 0;
+
+            /* Generators that can be called concurrently return true so
+             * that bulk generation does not serialize their calls */
+            virtual bool ThreadSafe() const
+            {
+                return false;
+            }
     };
 
-    template<typename T, typename P>
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>>
     class VoronoiTile : public pg::Serializable
     {
         public:
-            VoronoiTile(const DistanceModifier<T> &dModifier =
-                            DistanceModifier<T>::defaultDistanceModifier):
-                distanceModifier(dModifier)
-            {
-            }
+            VoronoiTile() = default;
 
-            VoronoiTile(const std::vector<VoronoiSite<T, P>> &s,
-                        const DistanceModifier<T> &dModifier =
-                            DistanceModifier<T>::defaultDistanceModifier):
-                sites(s),
-                distanceModifier(dModifier)
+            VoronoiTile(const std::vector<VoronoiSite<T, P>> &s):
+                sites(s)
             {
             }
 
+            VoronoiTile(const VoronoiTile &) = default;
+            VoronoiTile(VoronoiTile &&) = default;
+            VoronoiTile &operator=(const VoronoiTile &) = default;
+            VoronoiTile &operator=(VoronoiTile &&) = default;
+
             virtual ~VoronoiTile() = default;
 
             VoronoiSite<T, P> &SiteAt(const VPoint<T> &point, size_t &index,
-                                      float &distance)
+                                      T &distance)
+            {
+                const VoronoiTile &tile = *this;
+                return const_cast<VoronoiSite<T, P>&>(
+                    tile.SiteAt(point, index, distance));
+            }
+
+            const VoronoiSite<T, P> &SiteAt(const VPoint<T> &point,
+                                            size_t &index, T &distance) const
             {
                 if(sites.size() == 0)
                 {
@@ -138,14 +266,11 @@ namespace pg
                 }
 
                 index = 0;
-                T minDistance2 = dist2(point, sites[0].point);
-                T minDistance = minDistance2
-                              + distanceModifier(point, sites[0].point);
+                T minDistance = Metric::Distance(point, sites[0]);
 
                 for(size_t i = 1; i < sites.size(); ++i)
                 {
-                    T tmp = dist2(point, sites[i].point)
-                          + distanceModifier(point, sites[i].point);
+                    T tmp = Metric::Distance(point, sites[i]);
                     if(tmp < minDistance)
                     {
                         minDistance = tmp;
@@ -156,6 +281,17 @@ namespace pg
 
                 return sites[index];
             }
+
+            /* Sites are stored row by row, one per sub-cell of the tile */
+            std::vector<VoronoiSite<T, P>> &Sites()
+            {
+                return sites;
+            }
+
+            const std::vector<VoronoiSite<T, P>> &Sites() const
+            {
+                return sites;
+            }
             
             pg::InputStream &Deserialize(pg::InputStream &stream)
             {
@@ -171,14 +307,13 @@ namespace pg
             pg::OutputStream &Serialize(pg::OutputStream &stream) const
             {
                 stream << sites.size();
-                for(auto site : sites)
+                for(const auto &site : sites)
                     stream << site;
                 return stream;
             }
 
         protected:
             std::vector<VoronoiSite<T, P>> sites;
-            const DistanceModifier<T> &distanceModifier;
     };
 }
 
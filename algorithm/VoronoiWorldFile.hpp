@@ -0,0 +1,591 @@
+#ifndef VORONOI_WORLD_FILE_HPP
+#define VORONOI_WORLD_FILE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "VoronoiMesh.hpp"
+#include "CompactVoronoiTile.hpp"
+#include "../core/Endian.hpp"
+#include "../core/Varint.hpp"
+#include "../core/MappedFile.hpp"
+
+namespace pg
+{
+    /* World file layout, every field being little-endian:
+     *   header     see VoronoiWorldHeader, HEADER_SIZE bytes
+     *   payloads   one per tile, in any order
+     *   directory  tileCount entries sorted by (x, y), ENTRY_SIZE bytes
+     *              each, starting at directoryOffset
+     * A raw tile payload is its site count as uint32 followed by, for every
+     * site, x and y on scalarSize bytes and the serialized properties.
+     * With FLAG_COMPRESSED, see WriteWorldTile(). Version 2 files written
+     * before the relaxation was stored have 0 iterations. */
+    struct VoronoiWorldHeader
+    {
+        static const uint32_t MAGIC = 0x57564750; // "PGVW"
+        static const uint32_t VERSION = 2;
+        static const uint32_t FLAG_COMPRESSED = 1;
+        static const size_t HEADER_SIZE = 72;
+        static const size_t ENTRY_SIZE = 24;
+
+        uint32_t version;
+        uint32_t scalarSize;
+        uint32_t flags;
+        uint64_t tileDensityX;
+        uint64_t tileDensityY;
+        double unitX;
+        double unitY;
+        uint32_t seed;
+        uint16_t relaxationIterations;
+        uint16_t relaxationSamples;
+        uint64_t tileCount;
+        uint64_t directoryOffset;
+
+        VoronoiWorldHeader():
+            version(VERSION),
+            scalarSize(0),
+            flags(0),
+            tileDensityX(0),
+            tileDensityY(0),
+            unitX(0),
+            unitY(0),
+            seed(0),
+            relaxationIterations(0),
+            relaxationSamples(0),
+            tileCount(0),
+            directoryOffset(0)
+        {
+        }
+
+        pg::OutputStream &Serialize(pg::OutputStream &stream) const
+        {
+            uint32_t magic = MAGIC;
+            stream << magic << version << scalarSize << flags
+                   << tileDensityX << tileDensityY << unitX << unitY
+                   << seed << relaxationIterations << relaxationSamples
+                   << tileCount << directoryOffset;
+            return stream;
+        }
+
+        /* Whether both headers describe tiles generated the same way,
+         * whatever their encoding and content */
+        bool SameWorld(const VoronoiWorldHeader &b) const
+        {
+            return scalarSize == b.scalarSize
+                && tileDensityX == b.tileDensityX
+                && tileDensityY == b.tileDensityY
+                && unitX == b.unitX
+                && unitY == b.unitY
+                && seed == b.seed
+                && relaxationIterations == b.relaxationIterations
+                && relaxationSamples == b.relaxationSamples;
+        }
+
+        /* Throws if the data is not a world file of a supported version */
+        void Parse(const char *data, size_t size)
+        {
+            if(size < HEADER_SIZE
+            || LoadLittleEndian<uint32_t>(data) != MAGIC)
+                throw std::runtime_error("Not a Voronoi world file");
+
+            version         = LoadLittleEndian<uint32_t>(data + 4);
+            scalarSize      = LoadLittleEndian<uint32_t>(data + 8);
+            flags           = LoadLittleEndian<uint32_t>(data + 12);
+            tileDensityX    = LoadLittleEndian<uint64_t>(data + 16);
+            tileDensityY    = LoadLittleEndian<uint64_t>(data + 24);
+            unitX           = LoadLittleEndian<double>(data + 32);
+            unitY           = LoadLittleEndian<double>(data + 40);
+            seed            = LoadLittleEndian<uint32_t>(data + 48);
+            relaxationIterations = LoadLittleEndian<uint16_t>(data + 52);
+            relaxationSamples    = LoadLittleEndian<uint16_t>(data + 54);
+            tileCount       = LoadLittleEndian<uint64_t>(data + 56);
+            directoryOffset = LoadLittleEndian<uint64_t>(data + 64);
+
+            if(version == 0 || version > VERSION)
+                throw std::runtime_error("Unsupported world file version");
+            if(flags & ~FLAG_COMPRESSED)
+                throw std::runtime_error("Unsupported world file flags");
+            if(directoryOffset > size
+            || tileCount > (size - directoryOffset) / ENTRY_SIZE)
+                throw std::runtime_error("Truncated world file");
+        }
+    };
+
+    struct VoronoiWorldEntry
+    {
+        int32_t x;
+        int32_t y;
+        uint64_t offset;
+        uint64_t length;
+
+        bool operator<(const VoronoiWorldEntry &b) const
+        {
+            return x < b.x
+                || (x == b.x && y < b.y);
+        }
+
+        pg::OutputStream &Serialize(pg::OutputStream &stream) const
+        {
+            stream << x << y << offset << length;
+            return stream;
+        }
+
+        static VoronoiWorldEntry Load(const char *data)
+        {
+            VoronoiWorldEntry entry;
+            entry.x      = LoadLittleEndian<int32_t>(data);
+            entry.y      = LoadLittleEndian<int32_t>(data + 4);
+            entry.offset = LoadLittleEndian<uint64_t>(data + 8);
+            entry.length = LoadLittleEndian<uint64_t>(data + 16);
+            return entry;
+        }
+    };
+
+    template<typename T, typename P, typename Metric>
+    void writeRawTile(pg::OutputStream &stream,
+                      const VoronoiTile<T, P, Metric> &tile)
+    {
+        const auto &sites = tile.Sites();
+        stream << static_cast<uint32_t>(sites.size());
+        for(const auto &site : sites)
+            stream << site.point.x << site.point.y << site.properties;
+    }
+
+    template<typename T, typename P, typename Metric>
+    bool readRawTile(pg::InputStream &stream, size_t length,
+                     VoronoiTile<T, P, Metric> &tile)
+    {
+        uint32_t size;
+        stream >> size;
+        if(!stream.Good() || size > length)
+            return false;
+
+        auto &sites = tile.Sites();
+        sites.resize(size);
+        for(auto &site : sites)
+            stream >> site.point.x >> site.point.y >> site.properties;
+        return stream.Good();
+    }
+
+    /* Sub-cells of a tile, as laid out by VoronoiMesh */
+    template<typename T>
+    struct WorldTileGrid
+    {
+        WorldTileGrid(const VoronoiWorldHeader &header,
+                      const std::array<int, 2> &coord):
+            densityX(header.tileDensityX),
+            siteCount(header.tileDensityX * header.tileDensityY),
+            originX(coord[0] * T(header.unitX)),
+            originY(coord[1] * T(header.unitY)),
+            paceX(T(header.unitX) / header.tileDensityX),
+            paceY(T(header.unitY) / header.tileDensityY)
+        {
+        }
+
+        T CellMinX(size_t index) const
+        {
+            return originX + paceX * (index % densityX);
+        }
+
+        T CellMinY(size_t index) const
+        {
+            return originY + paceY * (index / densityX);
+        }
+
+        size_t densityX;
+        size_t siteCount;
+        T originX;
+        T originY;
+        T paceX;
+        T paceY;
+    };
+
+    enum WorldTileMode
+    {
+        RAW_TILE = 0,
+        QUANTIZED_TILE = 1
+    };
+
+    /* Writes the payload of the tile at coord in the encoding selected by
+     * the header. A compressed payload starts with a mode byte:
+     *   RAW_TILE        followed by a raw payload
+     *   QUANTIZED_TILE  for tiles with one site per sub-cell, in row order,
+     *                   followed by the x then y offset of every site in its
+     *                   sub-cell as uint16, which is within pace / 2^17 of
+     *                   the actual position, then runs of sites with equal
+     *                   properties as a varint length and the properties
+     * Counts are varints. Offsets are kept fixed-size since jitter makes
+     * them uniform, so varints would make them larger. */
+    template<typename T, typename P, typename Metric>
+    void WriteWorldTile(pg::OutputStream &stream,
+                        const VoronoiWorldHeader &header,
+                        const std::array<int, 2> &coord,
+                        const VoronoiTile<T, P, Metric> &tile)
+    {
+        typedef SubcellQuantizer<T, uint16_t> Quantizer;
+
+        if(!(header.flags & VoronoiWorldHeader::FLAG_COMPRESSED))
+        {
+            writeRawTile(stream, tile);
+            return;
+        }
+
+        const auto &sites = tile.Sites();
+        WorldTileGrid<T> grid(header, coord);
+        std::vector<uint16_t> offsets(2 * sites.size());
+        bool quantized = sites.size() == grid.siteCount;
+        for(size_t i = 0; quantized && i < sites.size(); ++i)
+        {
+            T minX = grid.CellMinX(i);
+            T minY = grid.CellMinY(i);
+            offsets[2*i  ] = Quantizer::Encode(sites[i].point.x, minX,
+                                               grid.paceX);
+            offsets[2*i+1] = Quantizer::Encode(sites[i].point.y, minY,
+                                               grid.paceY);
+
+            // Edited tiles may have moved sites out of their sub-cell
+            T errorX = Quantizer::Decode(offsets[2*i], minX, grid.paceX)
+                     - sites[i].point.x;
+            T errorY = Quantizer::Decode(offsets[2*i+1], minY, grid.paceY)
+                     - sites[i].point.y;
+            quantized = std::abs(errorX) <= grid.paceX / Quantizer::LEVELS
+                     && std::abs(errorY) <= grid.paceY / Quantizer::LEVELS;
+        }
+
+        if(!quantized)
+        {
+            stream << static_cast<uint8_t>(RAW_TILE);
+            writeRawTile(stream, tile);
+            return;
+        }
+
+        stream << static_cast<uint8_t>(QUANTIZED_TILE);
+        WriteVarint(stream, sites.size());
+        stream.WriteArray(offsets.data(), offsets.size());
+
+        // Properties are compared serialized, so P needs no operator==
+        std::vector<char> bytes;
+        std::vector<size_t> ends(sites.size());
+        {
+            pg::OutputStream propertyStream(bytes);
+            for(size_t i = 0; i < sites.size(); ++i)
+            {
+                propertyStream << sites[i].properties;
+                ends[i] = propertyStream.Written();
+            }
+        }
+
+        size_t runBegin = 0;
+        while(runBegin < sites.size())
+        {
+            size_t begin = runBegin > 0 ? ends[runBegin - 1] : 0;
+            size_t size = ends[runBegin] - begin;
+            size_t runEnd = runBegin + 1;
+            while(runEnd < sites.size()
+               && ends[runEnd] - ends[runEnd - 1] == size
+               && std::memcmp(bytes.data() + begin,
+                              bytes.data() + ends[runEnd - 1], size) == 0)
+                ++runEnd;
+
+            WriteVarint(stream, runEnd - runBegin);
+            stream.Write(bytes.data() + begin, size);
+            runBegin = runEnd;
+        }
+    }
+
+    /* Returns false if the payload is truncated or corrupted */
+    template<typename T, typename P, typename Metric>
+    bool ReadWorldTile(const VoronoiWorldHeader &header,
+                       const std::array<int, 2> &coord,
+                       const char *data, size_t length,
+                       VoronoiTile<T, P, Metric> &tile)
+    {
+        typedef SubcellQuantizer<T, uint16_t> Quantizer;
+
+        pg::InputStream stream(data, length);
+
+        if(!(header.flags & VoronoiWorldHeader::FLAG_COMPRESSED))
+            return readRawTile(stream, length, tile);
+
+        uint8_t mode;
+        stream >> mode;
+        if(mode == RAW_TILE)
+            return readRawTile(stream, length, tile);
+
+        WorldTileGrid<T> grid(header, coord);
+        uint64_t size = ReadVarint(stream);
+        if(mode != QUANTIZED_TILE || !stream.Good()
+        || size != grid.siteCount || 4 * size > length)
+            return false;
+
+        std::vector<uint16_t> offsets(2 * size);
+        stream.ReadArray(offsets.data(), offsets.size());
+
+        auto &sites = tile.Sites();
+        sites.resize(size);
+        for(size_t i = 0; i < size; ++i)
+        {
+            sites[i].point.x = Quantizer::Decode(offsets[2*i],
+                                                 grid.CellMinX(i),
+                                                 grid.paceX);
+            sites[i].point.y = Quantizer::Decode(offsets[2*i+1],
+                                                 grid.CellMinY(i),
+                                                 grid.paceY);
+        }
+
+        size_t i = 0;
+        while(i < size && stream.Good())
+        {
+            uint64_t run = ReadVarint(stream);
+            if(run == 0 || run > size - i)
+                return false;
+
+            stream >> sites[i].properties;
+            for(size_t j = i + 1; j < i + run; ++j)
+                sites[j].properties = sites[i].properties;
+            i += run;
+        }
+        return stream.Good();
+    }
+
+    /* Streams tiles to a seekable std::ostream, which must be at offset 0
+     * since directory offsets are counted from where the writer started.
+     * The directory is kept in memory and written by Finish(). */
+    template<typename T, typename P>
+    class VoronoiWorldWriter
+    {
+        public:
+            VoronoiWorldWriter(std::ostream &s, size_t tDensityX,
+                               size_t tDensityY, T uX, T uY,
+                               unsigned int seed,
+                               uint32_t flags =
+                                   VoronoiWorldHeader::FLAG_COMPRESSED):
+                ostream(s),
+                stream(s)
+            {
+                if(s.tellp() != std::streampos(0))
+                {
+                    throw std::runtime_error("VoronoiWorldWriter should "
+                                             "start at offset 0");
+                }
+
+                header.scalarSize = sizeof(T);
+                header.tileDensityX = tDensityX;
+                header.tileDensityY = tDensityY;
+                header.unitX = uX;
+                header.unitY = uY;
+                header.seed = seed;
+                header.flags = flags;
+
+                // Written again by Finish() once complete
+                header.Serialize(stream);
+            }
+
+            virtual ~VoronoiWorldWriter() = default;
+
+            template<typename Metric>
+            void AddTile(const std::array<int, 2> &coord,
+                         const VoronoiTile<T, P, Metric> &tile)
+            {
+                VoronoiWorldEntry entry;
+                entry.x = coord[0];
+                entry.y = coord[1];
+                entry.offset = position();
+                WriteWorldTile(stream, header, coord, tile);
+                entry.length = position() - entry.offset;
+                directory.push_back(entry);
+            }
+
+            /* Adds an already serialized tile payload, which must be
+             * encoded as selected by Header() */
+            void AddPayload(const std::array<int, 2> &coord,
+                            const char *data, size_t length)
+            {
+                VoronoiWorldEntry entry;
+                entry.x = coord[0];
+                entry.y = coord[1];
+                entry.offset = position();
+                entry.length = length;
+                stream.Write(data, length);
+                directory.push_back(entry);
+            }
+
+            const VoronoiWorldHeader &Header() const
+            {
+                return header;
+            }
+
+            /* Relaxation the tiles were generated with, restored by
+             * MappedVoronoiMesh for the tiles missing from the file */
+            void SetRelaxation(size_t iterations, size_t samplesPerCell)
+            {
+                if(iterations > UINT16_MAX || samplesPerCell > UINT16_MAX)
+                    throw std::runtime_error("Relaxation too large to save");
+
+                header.relaxationIterations = iterations;
+                header.relaxationSamples = samplesPerCell;
+            }
+
+            void Finish()
+            {
+                std::sort(directory.begin(), directory.end());
+                for(size_t i = 1; i < directory.size(); ++i)
+                {
+                    if(!(directory[i - 1] < directory[i]))
+                        throw std::runtime_error("Duplicate tile in world");
+                }
+
+                header.tileCount = directory.size();
+                header.directoryOffset = position();
+                for(const auto &entry : directory)
+                    entry.Serialize(stream);
+
+                stream.Flush();
+                std::streampos end = ostream.tellp();
+                ostream.seekp(0);
+                header.Serialize(stream);
+                stream.Flush();
+                ostream.seekp(end);
+                ostream.flush();
+
+                if(!ostream)
+                    throw std::runtime_error("Cannot write world file");
+            }
+
+        protected:
+            uint64_t position() const
+            {
+                return stream.Written();
+            }
+
+            std::ostream &ostream;
+            pg::OutputStream stream;
+            VoronoiWorldHeader header;
+            std::vector<VoronoiWorldEntry> directory;
+    };
+
+    /* Compressed files store positions quantized, see WriteWorldTile() */
+    template<typename T, typename P, typename Metric>
+    void SaveVoronoiWorld(const VoronoiMesh<T, P, Metric> &mesh,
+                          const std::string &filename,
+                          uint32_t flags =
+                              VoronoiWorldHeader::FLAG_COMPRESSED)
+    {
+        std::ofstream file(filename.c_str(),
+                           std::ios_base::out | std::ios_base::binary);
+        if(!file)
+            throw std::runtime_error("Cannot open " + filename);
+
+        VoronoiWorldWriter<T, P> writer(file, mesh.TileDensityX(),
+                                        mesh.TileDensityY(), mesh.UnitX(),
+                                        mesh.UnitY(), mesh.Seed(), flags);
+        writer.SetRelaxation(mesh.RelaxationIterations(),
+                             mesh.RelaxationSamples());
+        for(const auto &tile : mesh.Tiles())
+            writer.AddTile(tile.first.coord, tile.second);
+        writer.Finish();
+    }
+
+    /* VoronoiMesh backed by a memory-mapped world file. Opening only reads
+     * the header: a tile is deserialized the first time At() or
+     * GenerateRegion() asks for it, after a binary search in the mapped
+     * directory. Tiles missing from the file are generated as usual, with
+     * the relaxation stored in the header. */
+    template<typename T, typename P, typename Metric = EuclideanMetric<T>>
+    class MappedVoronoiMesh : public VoronoiMesh<T, P, Metric>
+    {
+        public:
+            MappedVoronoiMesh(pg::NumberGenerator &ngenerator,
+                              PropertyGenerator<T, P> &pgenerator,
+                              const std::string &filename):
+                VoronoiMesh<T, P, Metric>(ngenerator, pgenerator),
+                file(filename)
+            {
+                header.Parse(file.Data(), file.Size());
+                if(header.scalarSize != sizeof(T))
+                    throw std::runtime_error("World file scalar mismatch");
+
+                this->tileDensityX = header.tileDensityX;
+                this->tileDensityY = header.tileDensityY;
+                this->unitX = header.unitX;
+                this->unitY = header.unitY;
+                this->seed = header.seed;
+                this->SetRelaxation(header.relaxationIterations,
+                                    header.relaxationSamples);
+            }
+
+            virtual ~MappedVoronoiMesh() = default;
+
+            /* Number of tiles stored in the file */
+            size_t StoredTileCount() const
+            {
+                return header.tileCount;
+            }
+
+        protected:
+            VoronoiTile<T, P, Metric> &increment(
+                const std::array<int, 2> &coord)
+            {
+                if(!loadTile(coord))
+                    return VoronoiMesh<T, P, Metric>::increment(coord);
+                return this->tiles.find(coord)->second;
+            }
+
+            bool loadTile(const std::array<int, 2> &coord)
+            {
+                VoronoiWorldEntry entry;
+                if(!findEntry(coord, entry))
+                    return false;
+
+                if(entry.offset > file.Size()
+                || entry.length > file.Size() - entry.offset)
+                    throw std::runtime_error("Corrupted world file entry");
+
+                VoronoiTile<T, P, Metric> tile;
+                if(!ReadWorldTile(header, coord, file.Data() + entry.offset,
+                                  entry.length, tile))
+                    throw std::runtime_error("Corrupted world file tile");
+
+                this->tiles.insert({coord, std::move(tile)});
+                return true;
+            }
+
+            bool findEntry(const std::array<int, 2> &coord,
+                           VoronoiWorldEntry &entry) const
+            {
+                const char *directory = file.Data()
+                                      + header.directoryOffset;
+                VoronoiWorldEntry key;
+                key.x = coord[0];
+                key.y = coord[1];
+
+                size_t begin = 0;
+                size_t end = header.tileCount;
+                while(begin < end)
+                {
+                    size_t middle = begin + (end - begin) / 2;
+                    entry = VoronoiWorldEntry::Load(directory
+                        + middle * VoronoiWorldHeader::ENTRY_SIZE);
+                    if(entry < key)
+                        begin = middle + 1;
+                    else if(key < entry)
+                        end = middle;
+                    else
+                        return true;
+                }
+                return false;
+            }
+
+            MappedFile file;
+            VoronoiWorldHeader header;
+    };
+}
+
+#endif
+
@@ -0,0 +1,66 @@
+#ifndef CHECKSUM_HPP
+#define CHECKSUM_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+namespace pg
+{
+    /* CRC-32 (IEEE 802.3). Pass the previous result as crc to checksum
+     * data split in several parts. */
+    inline uint32_t Crc32(const void *data, size_t size, uint32_t crc = 0)
+    {
+        struct Table
+        {
+            uint32_t values[256];
+
+            Table()
+            {
+                for(uint32_t i = 0; i < 256; ++i)
+                {
+                    uint32_t c = i;
+                    for(int k = 0; k < 8; ++k)
+                        c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+                    values[i] = c;
+                }
+            }
+        };
+        static const Table TABLE;
+
+        const uint8_t *bytes = static_cast<const uint8_t*>(data);
+        crc = ~crc;
+        for(size_t i = 0; i < size; ++i)
+            crc = TABLE.values[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    /* Adler-32, as used by zlib. Pass the previous result as adler to
+     * checksum data split in several parts. */
+    inline uint32_t Adler32(const void *data, size_t size, uint32_t adler = 1)
+    {
+        // Largest count of bytes before the sums can overflow 32 bits
+        const size_t BLOCK = 5552;
+        const uint32_t MOD = 65521;
+
+        const uint8_t *bytes = static_cast<const uint8_t*>(data);
+        uint32_t a = adler & 0xffff;
+        uint32_t b = adler >> 16;
+        while(size > 0)
+        {
+            size_t n = size < BLOCK ? size : BLOCK;
+            size -= n;
+            for(size_t i = 0; i < n; ++i)
+            {
+                a += bytes[i];
+                b += a;
+            }
+            bytes += n;
+            a %= MOD;
+            b %= MOD;
+        }
+        return (b << 16) | a;
+    }
+}
+
+#endif
+
@@ -0,0 +1,47 @@
+#ifndef ENDIAN_HPP
+#define ENDIAN_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace pg
+{
+    inline bool HostIsLittleEndian()
+    {
+        const uint16_t ONE = 1;
+        uint8_t firstByte;
+        std::memcpy(&firstByte, &ONE, 1);
+        return firstByte == 1;
+    }
+
+    /* Converts between host and little-endian byte orders, both ways */
+    template<typename T>
+    T LittleEndian(T x)
+    {
+        if(!HostIsLittleEndian())
+        {
+            char *bytes = reinterpret_cast<char*>(&x);
+            std::reverse(bytes, bytes + sizeof(T));
+        }
+        return x;
+    }
+
+    template<typename T>
+    T LoadLittleEndian(const void *data)
+    {
+        T x;
+        std::memcpy(&x, data, sizeof(T));
+        return LittleEndian(x);
+    }
+
+    template<typename T>
+    void StoreLittleEndian(void *data, T x)
+    {
+        x = LittleEndian(x);
+        std::memcpy(data, &x, sizeof(T));
+    }
+}
+
+#endif
+
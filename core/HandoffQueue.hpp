@@ -0,0 +1,86 @@
+#ifndef HANDOFF_QUEUE_HPP
+#define HANDOFF_QUEUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace pg
+{
+    /* Lock-free handoff from any number of producer threads to a single
+     * consumer thread. Producers push with a compare-and-swap on the head
+     * of a linked list and the consumer takes the whole list at once with
+     * an exchange, which never blocks either side and cannot suffer from
+     * the ABA problem. */
+    template<typename T>
+    class HandoffQueue
+    {
+        public:
+            HandoffQueue():
+                head(nullptr)
+            {
+            }
+
+            virtual ~HandoffQueue()
+            {
+                Node *node = head.load(std::memory_order_acquire);
+                while(node != nullptr)
+                {
+                    Node *next = node->next;
+                    delete node;
+                    node = next;
+                }
+            }
+
+            HandoffQueue(const HandoffQueue &) = delete;
+            HandoffQueue &operator=(const HandoffQueue &) = delete;
+
+            void Push(std::unique_ptr<T> item)
+            {
+                Node *node = new Node{std::move(item), nullptr};
+                node->next = head.load(std::memory_order_relaxed);
+                while(!head.compare_exchange_weak(node->next, node,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed))
+                {
+                }
+            }
+
+            /* Appends every item pushed so far to items, in push order.
+             * Only one thread may call it. */
+            void TakeAll(std::vector<std::unique_ptr<T>> &items)
+            {
+                Node *node = head.exchange(nullptr,
+                                           std::memory_order_acquire);
+
+                // The list is newest first
+                Node *reversed = nullptr;
+                while(node != nullptr)
+                {
+                    Node *next = node->next;
+                    node->next = reversed;
+                    reversed = node;
+                    node = next;
+                }
+
+                while(reversed != nullptr)
+                {
+                    Node *next = reversed->next;
+                    items.push_back(std::move(reversed->item));
+                    delete reversed;
+                    reversed = next;
+                }
+            }
+
+        protected:
+            struct Node
+            {
+                std::unique_ptr<T> item;
+                Node *next;
+            };
+
+            std::atomic<Node*> head;
+    };
+}
+
+#endif
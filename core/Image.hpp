@@ -0,0 +1,216 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Checksum.hpp"
+#include "Serializable.hpp"
+
+namespace pg
+{
+    /* RGBA image in CPU memory, 4 bytes per pixel, rows top to bottom */
+    class Image
+    {
+        public:
+            Image(size_t w = 0, size_t h = 0):
+                width(w),
+                height(h),
+                pixels(w * h * 4)
+            {
+            }
+
+            virtual ~Image() = default;
+
+            void Resize(size_t w, size_t h)
+            {
+                width = w;
+                height = h;
+                pixels.resize(w * h * 4);
+            }
+
+            size_t Width() const
+            {
+                return width;
+            }
+
+            size_t Height() const
+            {
+                return height;
+            }
+
+            uint8_t *Pixel(size_t x, size_t y)
+            {
+                return pixels.data() + (x + y * width) * 4;
+            }
+
+            const uint8_t *Pixel(size_t x, size_t y) const
+            {
+                return pixels.data() + (x + y * width) * 4;
+            }
+
+            std::vector<uint8_t> &Pixels()
+            {
+                return pixels;
+            }
+
+            const std::vector<uint8_t> &Pixels() const
+            {
+                return pixels;
+            }
+
+        protected:
+            size_t width;
+            size_t height;
+            std::vector<uint8_t> pixels;
+    };
+
+    /* Binary PPM (P6), without the alpha channel */
+    inline void WritePPM(OutputStream &stream, const Image &image)
+    {
+        std::string header = "P6\n" + std::to_string(image.Width()) + " "
+                           + std::to_string(image.Height()) + "\n255\n";
+        stream.Write(header.data(), header.size());
+
+        std::vector<uint8_t> row(image.Width() * 3);
+        for(size_t y = 0; y < image.Height(); ++y)
+        {
+            const uint8_t *pixel = image.Pixel(0, y);
+            for(size_t x = 0; x < image.Width(); ++x, pixel += 4)
+                std::copy(pixel, pixel + 3, row.begin() + x * 3);
+            stream.Write(row.data(), row.size());
+        }
+    }
+
+    inline void storeBigEndian32(uint8_t *out, uint32_t value)
+    {
+        out[0] = value >> 24;
+        out[1] = value >> 16;
+        out[2] = value >> 8;
+        out[3] = value;
+    }
+
+    inline void writePNGChunk(OutputStream &stream, const char *type,
+                              const uint8_t *data, size_t size)
+    {
+        uint8_t length[4];
+        storeBigEndian32(length, size);
+        uint32_t crc = Crc32(type, 4);
+        crc = Crc32(data, size, crc);
+        uint8_t checksum[4];
+        storeBigEndian32(checksum, crc);
+
+        stream.Write(length, 4);
+        stream.Write(type, 4);
+        stream.Write(data, size);
+        stream.Write(checksum, 4);
+    }
+
+    /* 8-bit RGBA PNG. The zlib stream is made of stored (uncompressed)
+     * deflate blocks, which keeps the encoder a few lines long and as fast
+     * as a copy; use an external tool to shrink the files if needed. One
+     * IDAT chunk is written per block, so memory use does not depend on
+     * the image size. */
+    inline void WritePNG(OutputStream &stream, const Image &image)
+    {
+        const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a,
+                                      '\n'};
+        const size_t BLOCK_SIZE = 0xffff;
+        stream.Write(SIGNATURE, sizeof(SIGNATURE));
+
+        uint8_t header[13] = {};
+        storeBigEndian32(header, image.Width());
+        storeBigEndian32(header + 4, image.Height());
+        header[8] = 8; // Bits per channel
+        header[9] = 6; // RGBA
+        writePNGChunk(stream, "IHDR", header, sizeof(header));
+
+        // Scanlines, each prefixed by filter type 0, split in blocks
+        const size_t rowSize = image.Width() * 4 + 1;
+        const uint64_t rawSize = static_cast<uint64_t>(rowSize)
+                               * image.Height();
+        std::vector<uint8_t> chunk;
+        chunk.reserve(2 + 5 + BLOCK_SIZE);
+        chunk.push_back(0x78); // zlib header, no dictionary
+        chunk.push_back(0x01);
+
+        uint32_t adler = 1;
+        uint64_t position = 0;
+        do
+        {
+            size_t size = std::min<uint64_t>(BLOCK_SIZE, rawSize - position);
+            bool last = position + size == rawSize;
+            chunk.push_back(last ? 1 : 0);
+            chunk.push_back(size & 0xff);
+            chunk.push_back(size >> 8);
+            chunk.push_back(~size & 0xff);
+            chunk.push_back((~size >> 8) & 0xff);
+
+            size_t begin = chunk.size();
+            for(uint64_t i = position; i < position + size;)
+            {
+                size_t y = i / rowSize;
+                size_t x = i % rowSize;
+                if(x == 0)
+                {
+                    chunk.push_back(0);
+                    ++i;
+                    continue;
+                }
+
+                size_t n = std::min<uint64_t>(rowSize - x,
+                                              position + size - i);
+                const uint8_t *row = image.Pixel(0, y) + (x - 1);
+                chunk.insert(chunk.end(), row, row + n);
+                i += n;
+            }
+            adler = Adler32(chunk.data() + begin, chunk.size() - begin,
+                            adler);
+
+            if(last)
+            {
+                uint8_t trailer[4];
+                storeBigEndian32(trailer, adler);
+                chunk.insert(chunk.end(), trailer, trailer + 4);
+            }
+            writePNGChunk(stream, "IDAT", chunk.data(), chunk.size());
+            chunk.clear();
+            position += size;
+        }
+        while(position < rawSize);
+
+        writePNGChunk(stream, "IEND", chunk.data(), 0);
+    }
+
+    /* Writes a PNG or a PPM depending on the extension of filename */
+    inline void SaveImage(const Image &image, const std::string &filename)
+    {
+        std::string extension = filename.size() >= 4
+                              ? filename.substr(filename.size() - 4) : "";
+        if(extension != ".ppm" && extension != ".png")
+            throw std::runtime_error("Unknown image format: " + filename);
+
+        std::ofstream file(filename.c_str(),
+                           std::ios_base::out | std::ios_base::binary);
+        if(!file)
+            throw std::runtime_error("Cannot open " + filename);
+
+        {
+            OutputStream stream(file);
+            if(extension == ".ppm")
+                WritePPM(stream, image);
+            else
+                WritePNG(stream, image);
+        }
+
+        file.flush();
+        if(!file)
+            throw std::runtime_error("Cannot write " + filename);
+    }
+}
+
+#endif
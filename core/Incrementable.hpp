@@ -22,20 +22,6 @@ namespace pg
         {
         }
         
-        pg::InputStream &Deserialize(pg::InputStream &stream)
-        {
-            for(auto c : coord)
-                stream >> c;
-            return stream;
-        }
-        
-        pg::OutputStream &Serialize(pg::OutputStream &stream) const
-        {
-            for(size_t i = 0; i < DIM; ++i)
-                stream << coord[i];
-            return stream;
-        }
-    
         bool operator<(const TileCoord<DIM> &b) const
         {
             for(size_t i = 0; i < DIM; ++i)
@@ -49,6 +35,22 @@ namespace pg
         }
     };
 
+    template<size_t DIM>
+    struct Serializer<TileCoord<DIM>>
+    {
+        static void Serialize(OutputStream &stream, const TileCoord<DIM> &x)
+        {
+            for(size_t i = 0; i < DIM; ++i)
+                stream << x.coord[i];
+        }
+
+        static void Deserialize(InputStream &stream, TileCoord<DIM> &x)
+        {
+            for(auto &c : x.coord)
+                stream >> c;
+        }
+    };
+
     template<typename T, size_t DIM>
     class Incrementable
     {
@@ -81,6 +83,11 @@ namespace pg
                 return false;
             }
 
+            const std::map<TileCoord<DIM>, T> &Tiles() const
+            {
+                return tiles;
+            }
+
         protected:
             virtual T &increment(const std::array<int, DIM> &coord) = 0;
 
@@ -0,0 +1,63 @@
+#ifndef LAYERED_MAP_HPP
+#define LAYERED_MAP_HPP
+
+#include <array>
+#include <tuple>
+#include <utility>
+
+#include "Incrementable.hpp"
+
+namespace pg
+{
+    /* Tiles made of one tile of each layer, generated together the first
+     * time any of them is accessed and stored side by side, so that all
+     * the layers of a location cost a single lookup. A layer generates the
+     * tiles of one kind of data:
+     *
+     *     typedef ... Tile;
+     *     Tile operator()(const std::array<int, DIM> &coord);
+     *
+     * Layers are called in order and must outlive the map. */
+    template<size_t DIM, typename... Layers>
+    class LayeredMap :
+        public pg::Incrementable<std::tuple<typename Layers::Tile...>, DIM>
+    {
+        public:
+            typedef std::tuple<typename Layers::Tile...> Tile;
+
+            LayeredMap(pg::NumberGenerator &ngenerator, Layers &...l):
+                pg::Incrementable<Tile, DIM>(ngenerator),
+                layers(l...)
+            {
+            }
+
+            virtual ~LayeredMap() = default;
+
+            /* Tile of layer I at coord */
+            template<size_t I>
+            typename std::tuple_element<I, Tile>::type &Layer(
+                const std::array<int, DIM> &coord)
+            {
+                return std::get<I>(this->At(coord));
+            }
+
+        protected:
+            Tile &increment(const std::array<int, DIM> &coord)
+            {
+                return this->tiles.insert({coord, generate(coord,
+                    std::index_sequence_for<Layers...>())}).first->second;
+            }
+
+            template<size_t... I>
+            Tile generate(const std::array<int, DIM> &coord,
+                          std::index_sequence<I...>)
+            {
+                // Braces evaluate the layers from left to right
+                return Tile{std::get<I>(layers)(coord)...};
+            }
+
+            std::tuple<Layers&...> layers;
+    };
+}
+
+#endif
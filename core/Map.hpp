@@ -26,12 +26,6 @@ namespace pg
         {
         }
 
-        MapPoint(const MapPoint &other):
-            x(other.x),
-            y(other.y)
-        {
-        }
-        
         bool operator!=(const MapPoint &other) const
         {
             return x != other.x || y != other.y;
@@ -0,0 +1,79 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace pg
+{
+    /* Read-only memory mapping of a whole file */
+    class MappedFile
+    {
+        public:
+            MappedFile(const std::string &filename):
+                data(nullptr),
+                size(0)
+            {
+                int fd = open(filename.c_str(), O_RDONLY);
+                if(fd < 0)
+                {
+                    throw std::runtime_error("MappedFile: cannot open "
+                                             + filename);
+                }
+
+                struct stat info;
+                if(fstat(fd, &info) != 0)
+                {
+                    close(fd);
+                    throw std::runtime_error("MappedFile: cannot stat "
+                                             + filename);
+                }
+
+                size = info.st_size;
+                if(size > 0)
+                {
+                    void *address = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+                                         fd, 0);
+                    if(address == MAP_FAILED)
+                    {
+                        close(fd);
+                        throw std::runtime_error("MappedFile: cannot map "
+                                                 + filename);
+                    }
+                    data = static_cast<const char*>(address);
+                }
+                close(fd);
+            }
+
+            virtual ~MappedFile()
+            {
+                if(data != nullptr)
+                    munmap(const_cast<char*>(data), size);
+            }
+
+            MappedFile(const MappedFile &) = delete;
+            MappedFile &operator=(const MappedFile &) = delete;
+
+            const char *Data() const
+            {
+                return data;
+            }
+
+            size_t Size() const
+            {
+                return size;
+            }
+
+        protected:
+            const char *data;
+            size_t size;
+    };
+}
+
+#endif
+
@@ -0,0 +1,41 @@
+#ifndef PROPERTY_PACK_HPP
+#define PROPERTY_PACK_HPP
+
+#include <vector>
+
+namespace pg
+{
+    /* Storage for the properties of the sites of a compact tile.
+     * Specialize it to pack properties tighter than a plain array, e.g.
+     * one bit per site for a boolean property. */
+    template<typename P>
+    class PropertyPack
+    {
+        public:
+            void Resize(size_t size)
+            {
+                properties.resize(size);
+            }
+
+            P Get(size_t index) const
+            {
+                return properties[index];
+            }
+
+            void Set(size_t index, const P &property)
+            {
+                properties[index] = property;
+            }
+
+            size_t MemoryUsage() const
+            {
+                return properties.capacity() * sizeof(P);
+            }
+
+        protected:
+            std::vector<P> properties;
+    };
+}
+
+#endif
+
@@ -2,6 +2,15 @@
 #define SERIALIZABLE_H
 
 #include <iostream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "Endian.hpp"
+#include "StreamBackend.hpp"
 
 namespace pg
 {
@@ -18,62 +27,385 @@ namespace pg
             virtual OutputStream &Serialize(OutputStream &stream) const = 0;
     };
 
+    /* Compile-time serialization, dispatched to by the stream operators.
+     * Specialize it with static Serialize(OutputStream &, const T &) and
+     * Deserialize(InputStream &, T &) functions to serialize a type without
+     * deriving it from Serializable, which costs a vtable pointer per
+     * object. Serializable is still supported as an opt-in adapter, and
+     * other types are copied raw, arithmetic ones being little-endian. */
+    template<typename T, typename Enable = void>
+    struct Serializer;
+
+    /* Types whose in-memory representation is their serialized one on a
+     * little-endian host, so that arrays of them are copied in one go.
+     * Specialize it for trivially copyable structs without padding. */
+    template<typename T>
+    struct IsBulkSerializable : public std::is_arithmetic<T>
+    {
+    };
+
+    /* Reads blocks of bufferSize bytes from a ByteSource, or reads
+     * straight from memory */
     class InputStream
     {
         public:
-            InputStream(std::istream &s, bool b = true):
-                stream(s),
-                binary(b)
+            static const size_t BUFFER_SIZE = 1 << 16;
+
+            InputStream(std::istream &s, bool b = true,
+                        size_t bufferSize = BUFFER_SIZE):
+                owned(new StdInputSource(s)),
+                source(owned.get()),
+                binary(b),
+                buffer(bufferSize > 0 ? bufferSize : 1),
+                data(buffer.data()),
+                begin(0),
+                end(0),
+                good(true)
             {
             }
 
-            template<class T, class=
-            typename std::enable_if<!std::is_base_of<Serializable, T>::value,
-                     InputStream &>::type>
+            InputStream(ByteSource &s, size_t bufferSize = BUFFER_SIZE):
+                source(&s),
+                binary(true),
+                buffer(bufferSize > 0 ? bufferSize : 1),
+                data(buffer.data()),
+                begin(0),
+                end(0),
+                good(true)
+            {
+            }
+
+            /* Reads the size bytes at bytes without copying them first */
+            InputStream(const char *bytes, size_t size):
+                source(nullptr),
+                binary(true),
+                data(bytes),
+                begin(0),
+                end(size),
+                good(true)
+            {
+            }
+
+            virtual ~InputStream() = default;
+
+            InputStream(const InputStream &) = delete;
+            InputStream &operator=(const InputStream &) = delete;
+
+            template<class T>
             InputStream &operator>>(T &x)
             {
-                // TODO: Fix endianness
-                stream.read(reinterpret_cast<char*>(&x), sizeof(T));
+                Serializer<T>::Deserialize(*this, x);
                 return *this;
             }
 
-            InputStream &operator>>(Serializable &x)
+            template<class T>
+            InputStream &operator>>(std::vector<T> &v)
+            {
+                uint64_t size;
+                *this >> size;
+                v.resize(size);
+                return ReadArray(v.data(), v.size());
+            }
+
+            template<class T>
+            typename std::enable_if<IsBulkSerializable<T>::value,
+                                    InputStream &>::type
+            ReadArray(T *values, size_t count)
             {
-                return x.Deserialize(*this);
+                Read(values, count * sizeof(T));
+                if(!HostIsLittleEndian())
+                    for(size_t i = 0; i < count; ++i)
+                        values[i] = pg::LittleEndian(values[i]);
+                return *this;
+            }
+
+            template<class T>
+            typename std::enable_if<!IsBulkSerializable<T>::value,
+                                    InputStream &>::type
+            ReadArray(T *values, size_t count)
+            {
+                for(size_t i = 0; i < count; ++i)
+                    *this >> values[i];
+                return *this;
+            }
+
+            /* Reads ahead from the source in blocks, so the position of the
+             * latter is past the last value read */
+            void Read(void *bytes, size_t size)
+            {
+                char *out = static_cast<char*>(bytes);
+                while(size > 0)
+                {
+                    if(begin == end)
+                    {
+                        // Large reads bypass the buffer
+                        size_t n = size >= buffer.size() ? readDirect(out, size)
+                                                         : fill();
+                        if(n == 0)
+                        {
+                            good = false;
+                            std::memset(out, 0, size);
+                            return;
+                        }
+                        if(begin == end)
+                        {
+                            out += n;
+                            size -= n;
+                            continue;
+                        }
+                    }
+
+                    size_t n = std::min(size, end - begin);
+                    std::memcpy(out, data + begin, n);
+                    begin += n;
+                    out += n;
+                    size -= n;
+                }
+            }
+
+            /* False once a read went past the end of the data */
+            bool Good() const
+            {
+                return good;
             }
 
         protected:
-            std::istream &stream;
+            size_t readDirect(char *out, size_t size)
+            {
+                if(!good || source == nullptr)
+                    return 0;
+                return source->ReadSome(out, size);
+            }
+
+            size_t fill()
+            {
+                if(!good || source == nullptr)
+                    return 0;
+                data = buffer.data();
+                begin = 0;
+                end = source->ReadSome(buffer.data(), buffer.size());
+                return end;
+            }
+
+            std::unique_ptr<ByteSource> owned;
+            ByteSource *source;
             bool binary;
+            std::vector<char> buffer;
+            const char *data;
+            size_t begin;
+            size_t end;
+            bool good;
     };
 
+    /* Writes blocks of bufferSize bytes to a ByteSink, or appends straight
+     * to a byte vector */
     class OutputStream
     {
         public:
-            OutputStream(std::ostream &s, bool b = true):
-                stream(s),
-                binary(b)
+            static const size_t BUFFER_SIZE = 1 << 16;
+
+            OutputStream(std::ostream &s, bool b = true,
+                         size_t bufferSize = BUFFER_SIZE):
+                owned(new StdOutputSink(s)),
+                sink(owned.get()),
+                target(nullptr),
+                binary(b),
+                buffer(bufferSize > 0 ? bufferSize : 1),
+                data(buffer.data()),
+                capacity(buffer.size()),
+                used(0),
+                written(0),
+                good(true)
+            {
+            }
+
+            OutputStream(ByteSink &s, size_t bufferSize = BUFFER_SIZE):
+                sink(&s),
+                target(nullptr),
+                binary(true),
+                buffer(bufferSize > 0 ? bufferSize : 1),
+                data(buffer.data()),
+                capacity(buffer.size()),
+                used(0),
+                written(0),
+                good(true)
+            {
+            }
+
+            /* Appends to bytes, which is used as the buffer: its size is
+             * only right once the stream is flushed or destroyed. Clearing
+             * and reusing it avoids allocations. */
+            OutputStream(std::vector<char> &bytes):
+                sink(nullptr),
+                target(&bytes),
+                targetBase(bytes.size()),
+                binary(true),
+                data(nullptr),
+                capacity(0),
+                used(0),
+                written(0),
+                good(true)
+            {
+            }
+
+            virtual ~OutputStream()
             {
+                Flush();
             }
 
-            template<class T, class=
-            typename std::enable_if<!std::is_base_of<Serializable, T>::value,
-                     OutputStream &>::type>
-                OutputStream &operator<<(const T &x)
+            OutputStream(const OutputStream &) = delete;
+            OutputStream &operator=(const OutputStream &) = delete;
+
+            template<class T>
+            OutputStream &operator<<(const T &x)
             {
-                // TODO: Fix endianness
-                stream.write(reinterpret_cast<const char*>(&x), sizeof(T));
+                Serializer<T>::Serialize(*this, x);
                 return *this;
             }
 
-            OutputStream &operator<<(const Serializable &x)
+            template<class T>
+            OutputStream &operator<<(const std::vector<T> &v)
             {
-                return x.Serialize(*this);
+                *this << static_cast<uint64_t>(v.size());
+                return WriteArray(v.data(), v.size());
+            }
+
+            /* A single copy on little-endian hosts */
+            template<class T>
+            typename std::enable_if<IsBulkSerializable<T>::value,
+                                    OutputStream &>::type
+            WriteArray(const T *values, size_t count)
+            {
+                if(HostIsLittleEndian())
+                    Write(values, count * sizeof(T));
+                else
+                    for(size_t i = 0; i < count; ++i)
+                        *this << values[i];
+                return *this;
+            }
+
+            template<class T>
+            typename std::enable_if<!IsBulkSerializable<T>::value,
+                                    OutputStream &>::type
+            WriteArray(const T *values, size_t count)
+            {
+                for(size_t i = 0; i < count; ++i)
+                    *this << values[i];
+                return *this;
+            }
+
+            void Write(const void *bytes, size_t size)
+            {
+                written += size;
+                if(size > capacity - used && !makeRoom(bytes, size))
+                    return;
+
+                std::memcpy(data + used, bytes, size);
+                used += size;
+            }
+
+            /* Must be called before using the sink or vector directly */
+            void Flush()
+            {
+                if(target != nullptr)
+                {
+                    target->resize(targetBase + used);
+                    data = target->data() + targetBase;
+                    capacity = used;
+                }
+                else if(used > 0)
+                {
+                    good &= sink->WriteAll(buffer.data(), used);
+                    used = 0;
+                }
+            }
+
+            /* False once the sink failed to write */
+            bool Good() const
+            {
+                return good;
+            }
+
+            /* Number of bytes written through this stream so far */
+            uint64_t Written() const
+            {
+                return written;
             }
 
         protected:
-            std::ostream &stream;
+            /* Returns false if bytes were written without the buffer */
+            bool makeRoom(const void *bytes, size_t size)
+            {
+                if(target != nullptr)
+                {
+                    target->resize(targetBase
+                                 + std::max(2 * capacity, used + size));
+                    data = target->data() + targetBase;
+                    capacity = target->size() - targetBase;
+                    return true;
+                }
+
+                Flush();
+
+                // Large writes bypass the buffer
+                if(size >= capacity)
+                {
+                    good &= sink->WriteAll(static_cast<const char*>(bytes),
+                                           size);
+                    return false;
+                }
+                return true;
+            }
+
+            std::unique_ptr<ByteSink> owned;
+            ByteSink *sink;
+            std::vector<char> *target;
+            size_t targetBase;
             bool binary;
+            std::vector<char> buffer;
+            char *data;
+            size_t capacity;
+            size_t used;
+            uint64_t written;
+            bool good;
+    };
+
+    template<typename T, typename Enable>
+    struct Serializer
+    {
+        static void Serialize(OutputStream &stream, const T &x)
+        {
+            // Arithmetic values are stored little-endian
+            if(std::is_arithmetic<T>::value)
+            {
+                T tmp = pg::LittleEndian(x);
+                stream.Write(&tmp, sizeof(T));
+            }
+            else
+                stream.Write(&x, sizeof(T));
+        }
+
+        static void Deserialize(InputStream &stream, T &x)
+        {
+            stream.Read(&x, sizeof(T));
+            if(std::is_arithmetic<T>::value)
+                x = pg::LittleEndian(x);
+        }
+    };
+
+    template<typename T>
+    struct Serializer<T, typename std::enable_if<
+        std::is_base_of<Serializable, T>::value>::type>
+    {
+        static void Serialize(OutputStream &stream, const T &x)
+        {
+            x.Serialize(stream);
+        }
+
+        static void Deserialize(InputStream &stream, T &x)
+        {
+            x.Deserialize(stream);
+        }
     };
 }
 
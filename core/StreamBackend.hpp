@@ -0,0 +1,166 @@
+#ifndef STREAM_BACKEND_HPP
+#define STREAM_BACKEND_HPP
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+
+namespace pg
+{
+    /* Where an InputStream reads its blocks from */
+    class ByteSource
+    {
+        public:
+            ByteSource() = default;
+            virtual ~ByteSource() = default;
+
+            /* Reads up to size bytes, returns 0 at the end of the data or
+             * on error */
+            virtual size_t ReadSome(char *data, size_t size) = 0;
+    };
+
+    /* Where an OutputStream writes its blocks to */
+    class ByteSink
+    {
+        public:
+            ByteSink() = default;
+            virtual ~ByteSink() = default;
+
+            /* Returns false if not every byte could be written */
+            virtual bool WriteAll(const char *data, size_t size) = 0;
+    };
+
+    class StdInputSource : public ByteSource
+    {
+        public:
+            StdInputSource(std::istream &s):
+                stream(s)
+            {
+            }
+
+            virtual ~StdInputSource() = default;
+
+            virtual size_t ReadSome(char *data, size_t size)
+            {
+                stream.read(data, size);
+                return stream.gcount();
+            }
+
+        protected:
+            std::istream &stream;
+    };
+
+    class StdOutputSink : public ByteSink
+    {
+        public:
+            StdOutputSink(std::ostream &s):
+                stream(s)
+            {
+            }
+
+            virtual ~StdOutputSink() = default;
+
+            virtual bool WriteAll(const char *data, size_t size)
+            {
+                stream.write(data, size);
+                return static_cast<bool>(stream);
+            }
+
+        protected:
+            std::ostream &stream;
+    };
+
+    /* Reads from the current offset of a file descriptor, which is not
+     * closed */
+    class FileDescriptorSource : public ByteSource
+    {
+        public:
+            FileDescriptorSource(int f):
+                fd(f)
+            {
+            }
+
+            virtual ~FileDescriptorSource() = default;
+
+            virtual size_t ReadSome(char *data, size_t size)
+            {
+                ssize_t n;
+                do
+                    n = read(fd, data, size);
+                while(n < 0 && errno == EINTR);
+                return n > 0 ? n : 0;
+            }
+
+        protected:
+            int fd;
+    };
+
+    /* Writes at the current offset of a file descriptor, which is not
+     * closed */
+    class FileDescriptorSink : public ByteSink
+    {
+        public:
+            FileDescriptorSink(int f):
+                fd(f)
+            {
+            }
+
+            virtual ~FileDescriptorSink() = default;
+
+            virtual bool WriteAll(const char *data, size_t size)
+            {
+                while(size > 0)
+                {
+                    ssize_t n = write(fd, data, size);
+                    if(n < 0 && errno == EINTR)
+                        continue;
+                    if(n <= 0)
+                        return false;
+                    data += n;
+                    size -= n;
+                }
+                return true;
+            }
+
+        protected:
+            int fd;
+    };
+
+    /* Writes into a fixed-size memory area, failing once it is full */
+    class SpanSink : public ByteSink
+    {
+        public:
+            SpanSink(char *d, size_t s):
+                data(d),
+                size(s),
+                used(0)
+            {
+            }
+
+            virtual ~SpanSink() = default;
+
+            virtual bool WriteAll(const char *bytes, size_t count)
+            {
+                if(count > size - used)
+                    return false;
+                std::memcpy(data + used, bytes, count);
+                used += count;
+                return true;
+            }
+
+            /* Number of bytes written so far */
+            size_t Used() const
+            {
+                return used;
+            }
+
+        protected:
+            char *data;
+            size_t size;
+            size_t used;
+    };
+}
+
+#endif
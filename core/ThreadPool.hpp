@@ -0,0 +1,196 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <algorithm>
+#include <queue>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+
+namespace pg
+{
+    class ThreadPool
+    {
+        public:
+            ThreadPool(size_t threadCount =
+                           std::thread::hardware_concurrency()):
+                pending(0),
+                stop(false)
+            {
+                if(threadCount == 0)
+                    threadCount = 1;
+                for(size_t i = 0; i < threadCount; ++i)
+                    workers.emplace_back(&ThreadPool::run, this);
+            }
+
+            virtual ~ThreadPool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stop = true;
+                }
+                taskAvailable.notify_all();
+                for(auto &worker : workers)
+                    worker.join();
+            }
+
+            ThreadPool(const ThreadPool &) = delete;
+            ThreadPool &operator=(const ThreadPool &) = delete;
+
+            void Enqueue(const std::function<void()> &task)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    tasks.push(task);
+                    ++pending;
+                }
+                taskAvailable.notify_one();
+            }
+
+            /* Blocks until every enqueued task is done, then rethrows the
+             * first exception thrown by a task, if any */
+            void Wait()
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                allDone.wait(lock, [this]{ return pending == 0; });
+
+                if(error)
+                {
+                    std::exception_ptr e = error;
+                    error = nullptr;
+                    std::rethrow_exception(e);
+                }
+            }
+
+            size_t Size() const
+            {
+                return workers.size();
+            }
+
+        protected:
+            void run()
+            {
+                for(;;)
+                {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        taskAvailable.wait(lock, [this]
+                        {
+                            return stop || !tasks.empty();
+                        });
+                        if(tasks.empty())
+                            return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+
+                    try
+                    {
+                        task();
+                    }
+                    catch(...)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if(!error)
+                            error = std::current_exception();
+                    }
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(--pending == 0)
+                        allDone.notify_all();
+                }
+            }
+
+            std::vector<std::thread> workers;
+            std::queue<std::function<void()>> tasks;
+            std::mutex mutex;
+            std::condition_variable taskAvailable;
+            std::condition_variable allDone;
+            std::exception_ptr error;
+            size_t pending;
+            bool stop;
+    };
+
+    /* Calls f(i) for every i in [0, count), split in contiguous chunks
+     * over the workers of the pool, and waits for completion of these
+     * chunks only, then rethrows the first exception f threw, if any. The
+     * calling thread takes chunks as well, so it can be a task of the same
+     * pool, or share it with other users, without waiting for their
+     * tasks or for idle workers. */
+    template<typename F>
+    void ParallelFor(ThreadPool &pool, size_t count, F f)
+    {
+        // Shared with the helper tasks, which may start after the call
+        // returned and then find no chunk left
+        struct State
+        {
+            size_t chunkCount;
+            size_t next;
+            size_t done;
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable allDone;
+        };
+
+        auto state = std::make_shared<State>();
+        state->chunkCount = std::min(count, pool.Size() * 4);
+        state->next = 0;
+        state->done = 0;
+
+        auto run = [state, count, &f]
+        {
+            for(;;)
+            {
+                size_t chunk;
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if(state->next == state->chunkCount)
+                        return;
+                    chunk = state->next++;
+                }
+
+                size_t begin = count * chunk / state->chunkCount;
+                size_t end = count * (chunk + 1) / state->chunkCount;
+                std::exception_ptr error;
+                try
+                {
+                    for(size_t i = begin; i < end; ++i)
+                        f(i);
+                }
+                catch(...)
+                {
+                    error = std::current_exception();
+                }
+
+                // Notified under the lock, since the caller may return as
+                // soon as it sees the last chunk done
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if(error && !state->error)
+                    state->error = error;
+                if(++state->done == state->chunkCount)
+                    state->allDone.notify_all();
+            }
+        };
+
+        size_t helperCount = std::min(state->chunkCount, pool.Size());
+        for(size_t i = 0; i < helperCount; ++i)
+            pool.Enqueue(run);
+        run();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->allDone.wait(lock, [&state]
+        {
+            return state->done == state->chunkCount;
+        });
+        if(state->error)
+            std::rethrow_exception(state->error);
+    }
+}
+
+#endif
+
@@ -0,0 +1,44 @@
+#ifndef VARINT_HPP
+#define VARINT_HPP
+
+#include <cstdint>
+
+#include "Serializable.hpp"
+
+namespace pg
+{
+    /* LEB128: 7 bits per byte, least significant group first, the high bit
+     * telling whether another byte follows. Small values take one byte. */
+    inline void WriteVarint(OutputStream &stream, uint64_t value)
+    {
+        uint8_t bytes[10];
+        size_t size = 0;
+        while(value >= 0x80)
+        {
+            bytes[size++] = static_cast<uint8_t>(value) | 0x80;
+            value >>= 7;
+        }
+        bytes[size++] = static_cast<uint8_t>(value);
+        stream.Write(bytes, size);
+    }
+
+    /* Returns 0 and leaves the stream not Good() on truncated data */
+    inline uint64_t ReadVarint(InputStream &stream)
+    {
+        uint64_t value = 0;
+        for(unsigned int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte;
+            stream.Read(&byte, 1);
+            if(!stream.Good())
+                return 0;
+
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if(!(byte & 0x80))
+                return value;
+        }
+        return value;
+    }
+}
+
+#endif
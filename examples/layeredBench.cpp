@@ -0,0 +1,206 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <string>
+
+#include "../random/SeededNumberGenerator.hpp"
+#include "../noise/PerlinNoise2.hpp"
+#include "../algorithm/VoronoiMesh.hpp"
+#include "../algorithm/FieldLayer.hpp"
+#include "../core/LayeredMap.hpp"
+#include "../TileType.h"
+
+const float UNIT = 120;
+const size_t RESOLUTION = 16;
+const float NOISE_DETAIL = 1.f / 240.f;
+
+class NoiseIslands : public pg::PropertyGenerator<float, TileType>
+{
+    public:
+        NoiseIslands(pg::NumberGenerator &generator):
+            noise(generator)
+        {
+        }
+
+        virtual ~NoiseIslands() = default;
+
+        virtual TileType operator()(const pg::VPoint<float> &point)
+        {
+            return {noise({point.x * NOISE_DETAIL,
+                           point.y * NOISE_DETAIL}) > .6f};
+        }
+
+    protected:
+        pg::PerlinNoiseUniformFloat<2> noise;
+};
+
+struct Sample
+{
+    uint8_t island;
+    float elevation;
+    float moisture;
+    uint8_t biome;
+};
+
+template<typename F>
+double measureSeconds(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/* Tile holding point and the position of point across it */
+std::array<int, 2> tileOf(const pg::VPoint<float> &point, float &x, float &y)
+{
+    std::array<int, 2> coord = {{int(std::floor(point.x / UNIT)),
+                                 int(std::floor(point.y / UNIT))}};
+    x = point.x / UNIT - coord[0];
+    y = point.y / UNIT - coord[1];
+    return coord;
+}
+
+int main(int argc, char *argv[])
+{
+    int tileRadius = argc > 1 ? std::atoi(argv[1]) : 16;
+    size_t sampleCount = argc > 2 ? std::atoi(argv[2]) : 1 << 22;
+
+    pg::SeededNumberGenerator rngenerator(1);
+    NoiseIslands islands(rngenerator);
+    pg::VoronoiMesh<float, TileType> mesh(rngenerator, islands, 8, 8, UNIT,
+                                          UNIT);
+    pg::PerlinNoiseUniformFloat<2> elevationNoise(rngenerator);
+    pg::PerlinNoiseUniformFloat<2> moistureNoise(rngenerator);
+
+    auto elevationAt = [&](const pg::VPoint<float> &point)
+    {
+        return elevationNoise({point.x * NOISE_DETAIL,
+                               point.y * NOISE_DETAIL});
+    };
+    auto moistureAt = [&](const pg::VPoint<float> &point)
+    {
+        return moistureNoise({point.x * NOISE_DETAIL,
+                              point.y * NOISE_DETAIL});
+    };
+
+    auto islandLayer = pg::MakeFieldLayer<float, uint8_t>(
+        [&](const pg::VPoint<float> &point)
+        {
+            return mesh.SiteAt(point).properties.island;
+        }, UNIT, UNIT, RESOLUTION);
+    auto elevationLayer = pg::MakeFieldLayer<float, float>(elevationAt,
+        UNIT, UNIT, RESOLUTION);
+    auto moistureLayer = pg::MakeFieldLayer<float, float>(moistureAt,
+        UNIT, UNIT, RESOLUTION);
+    auto biomeLayer = pg::MakeFieldLayer<float, uint8_t>(
+        [&](const pg::VPoint<float> &point)
+        {
+            // 3 x 3 biomes, from dry lowlands to wet highlands
+            return uint8_t(std::min(int(elevationAt(point) * 3), 2) * 3
+                         + std::min(int(moistureAt(point) * 3), 2));
+        }, UNIT, UNIT, RESOLUTION);
+
+    typedef decltype(islandLayer) IslandLayer;
+    typedef decltype(elevationLayer) ElevationLayer;
+    typedef decltype(moistureLayer) MoistureLayer;
+    typedef decltype(biomeLayer) BiomeLayer;
+
+    pg::LayeredMap<2, IslandLayer> islandMap(rngenerator, islandLayer);
+    pg::LayeredMap<2, ElevationLayer> elevationMap(rngenerator,
+                                                   elevationLayer);
+    pg::LayeredMap<2, MoistureLayer> moistureMap(rngenerator, moistureLayer);
+    pg::LayeredMap<2, BiomeLayer> biomeMap(rngenerator, biomeLayer);
+    pg::LayeredMap<2, IslandLayer, ElevationLayer, MoistureLayer,
+                   BiomeLayer> layeredMap(rngenerator, islandLayer,
+                                          elevationLayer, moistureLayer,
+                                          biomeLayer);
+
+    // Same points for both, spread over the whole region
+    std::vector<pg::VPoint<float>> points(sampleCount);
+    float size = 2 * tileRadius * UNIT;
+    for(auto &point : points)
+    {
+        point.x = rngenerator() / float(rngenerator.max()) * size
+                - tileRadius * UNIT;
+        point.y = rngenerator() / float(rngenerator.max()) * size
+                - tileRadius * UNIT;
+    }
+
+    // Generating first, so that sampling is timed on its own
+    double generateTime = measureSeconds([&]
+    {
+        for(int y = -tileRadius; y < tileRadius; ++y)
+            for(int x = -tileRadius; x < tileRadius; ++x)
+            {
+                islandMap.At({{x, y}});
+                elevationMap.At({{x, y}});
+                moistureMap.At({{x, y}});
+                biomeMap.At({{x, y}});
+            }
+    });
+    double layeredGenerateTime = measureSeconds([&]
+    {
+        for(int y = -tileRadius; y < tileRadius; ++y)
+            for(int x = -tileRadius; x < tileRadius; ++x)
+                layeredMap.At({{x, y}});
+    });
+
+    std::vector<Sample> separate(points.size());
+    double separateTime = measureSeconds([&]
+    {
+        for(size_t i = 0; i < points.size(); ++i)
+        {
+            float x, y;
+            std::array<int, 2> coord = tileOf(points[i], x, y);
+            separate[i].island =
+                islandMap.Layer<0>(coord).Nearest(x, y);
+            separate[i].elevation =
+                elevationMap.Layer<0>(coord).Bilinear(x, y);
+            separate[i].moisture =
+                moistureMap.Layer<0>(coord).Bilinear(x, y);
+            separate[i].biome = biomeMap.Layer<0>(coord).Nearest(x, y);
+        }
+    });
+
+    std::vector<Sample> layered(points.size());
+    double layeredTime = measureSeconds([&]
+    {
+        for(size_t i = 0; i < points.size(); ++i)
+        {
+            float x, y;
+            const auto &tile = layeredMap.At(tileOf(points[i], x, y));
+            layered[i].island = std::get<0>(tile).Nearest(x, y);
+            layered[i].elevation = std::get<1>(tile).Bilinear(x, y);
+            layered[i].moisture = std::get<2>(tile).Bilinear(x, y);
+            layered[i].biome = std::get<3>(tile).Nearest(x, y);
+        }
+    });
+
+    size_t mismatches = 0;
+    for(size_t i = 0; i < points.size(); ++i)
+    {
+        mismatches += separate[i].island != layered[i].island
+                   || separate[i].elevation != layered[i].elevation
+                   || separate[i].moisture != layered[i].moisture
+                   || separate[i].biome != layered[i].biome;
+    }
+
+    std::cout << "Generate 4 maps: " << generateTime * 1000 << " ms, "
+              << "1 layered map: " << layeredGenerateTime * 1000 << " ms"
+              << std::endl
+              << "Sample 4 maps: " << separateTime * 1000 << " ms, "
+              << "1 layered map: " << layeredTime * 1000 << " ms for "
+              << points.size() << " points" << std::endl;
+    if(mismatches != 0)
+    {
+        std::cout << mismatches << " samples differ" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#include "../random/SeededNumberGenerator.hpp"
+#include "../noise/PerlinNoise2.hpp"
+#include "../algorithm/VoronoiMeshLOD.hpp"
+#include "../TileType.h"
+
+const float UNIT = 120;
+const size_t DENSITY = 8;
+const size_t LEVEL_COUNT = 6;
+const float NOISE_DETAIL = 1.f / 240.f;
+
+class NoiseIslands : public pg::PropertyGenerator<float, TileType>
+{
+    public:
+        NoiseIslands(pg::NumberGenerator &generator):
+            noise(generator)
+        {
+        }
+
+        virtual ~NoiseIslands() = default;
+
+        virtual TileType operator()(const pg::VPoint<float> &point)
+        {
+            return {noise({point.x * NOISE_DETAIL,
+                           point.y * NOISE_DETAIL}) > .6f};
+        }
+
+    protected:
+        pg::PerlinNoiseUniformFloat<2> noise;
+};
+
+/* Samples the same area at growing footprints, e.g. zooming out, and
+ * compares each level with level 0, whose properties coarse sites are
+ * reduced from. The land area should stay about the same. */
+int main(int argc, char *argv[])
+{
+    size_t sampleCount = argc > 1 ? std::atoi(argv[1]) : 1 << 16;
+
+    pg::SeededNumberGenerator rngenerator(1);
+    NoiseIslands islands(rngenerator);
+    pg::VoronoiMeshLOD<float, TileType> lod(rngenerator, islands, DENSITY,
+                                            DENSITY, UNIT, UNIT,
+                                            LEVEL_COUNT);
+
+    std::vector<pg::VPoint<float>> points(sampleCount);
+    float size = 8 * UNIT;
+    for(auto &point : points)
+    {
+        point.x = rngenerator() / float(rngenerator.max()) * size;
+        point.y = rngenerator() / float(rngenerator.max()) * size;
+    }
+
+    std::vector<bool> reference(points.size());
+    size_t referenceLand = 0;
+    for(size_t i = 0; i < points.size(); ++i)
+    {
+        reference[i] = lod.SiteAt(points[i], 0).properties.island;
+        referenceLand += reference[i];
+    }
+
+    std::cout << "Level 0: " << referenceLand * 100. / points.size()
+              << "% land" << std::endl;
+
+    // One footprint past the coarsest level, which it is clamped to
+    for(size_t k = 0; k <= LEVEL_COUNT; ++k)
+    {
+        float footprint = UNIT / DENSITY * (1 << k);
+        size_t level = lod.LevelFor(footprint);
+        size_t land = 0;
+        size_t agreeing = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < points.size(); ++i)
+        {
+            bool island = lod.SiteAt(points[i], footprint).properties.island;
+            land += island;
+            agreeing += island == reference[i];
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        std::cout << "Footprint " << footprint << ": level " << level
+                  << ", " << land * 100. / points.size() << "% land, "
+                  << agreeing * 100. / points.size()
+                  << "% agreeing with level 0, "
+                  << elapsed.count() * 1000 << " ms, "
+                  << lod.Level(level).Tiles().size() << " tiles"
+                  << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include <string>
+
+#include "../random/StdNumberGenerator.hpp"
+#include "../algorithm/VoronoiMesh.hpp"
+#include "../algorithm/VoronoiWorldFile.hpp"
+#include "../TileType.h"
+
+class StripeGenerator : public pg::PropertyGenerator<float, TileType>
+{
+    public:
+        StripeGenerator() = default;
+        virtual ~StripeGenerator() = default;
+
+        virtual TileType operator()(const pg::VPoint<float> &point)
+        {
+            return {static_cast<int>(point.x + point.y) % 512 < 128};
+        }
+
+        virtual bool ThreadSafe() const
+        {
+            return true;
+        }
+};
+
+template<typename F>
+double measureSeconds(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void report(const std::string &name, size_t bytes, double seconds)
+{
+    std::cout << name << ": " << bytes / (1024. * 1024.) << " MiB in "
+              << seconds * 1000 << " ms, "
+              << bytes / (1024. * 1024.) / seconds << " MiB/s" << std::endl;
+}
+
+void BenchMesh(pg::StdNumberGenerator &rngenerator, int tileRadius)
+{
+    StripeGenerator generator;
+    pg::VoronoiMesh<float, TileType> mesh(rngenerator, generator, 8, 8, 120,
+                                          120);
+    mesh.GenerateRegion({{-tileRadius, -tileRadius}},
+                        {{tileRadius - 1, tileRadius - 1}});
+
+    std::ostringstream out(std::ios_base::out | std::ios_base::binary);
+    double saveTime = measureSeconds([&]
+    {
+        pg::OutputStream stream(out);
+        stream << mesh;
+    });
+    std::string data = out.str();
+    report("Save mesh", data.size(), saveTime);
+
+    pg::VoronoiMesh<float, TileType> loaded(rngenerator, generator);
+    std::istringstream in(data, std::ios_base::in | std::ios_base::binary);
+    double loadTime = measureSeconds([&]
+    {
+        pg::InputStream stream(in);
+        stream >> loaded;
+    });
+    report("Load mesh", data.size(), loadTime);
+
+    // Same data through the memory backends, without iostreams
+    std::vector<char> bytes;
+    bytes.reserve(data.size());
+    double vectorTime = measureSeconds([&]
+    {
+        pg::OutputStream stream(bytes);
+        stream << mesh;
+    });
+    report("Save mesh to vector", bytes.size(), vectorTime);
+
+    pg::VoronoiMesh<float, TileType> spanLoaded(rngenerator, generator);
+    double spanTime = measureSeconds([&]
+    {
+        pg::InputStream stream(bytes.data(), bytes.size());
+        stream >> spanLoaded;
+    });
+    report("Load mesh from span", bytes.size(), spanTime);
+}
+
+/* Throughput is given in decoded tile bytes, to compare codecs */
+void BenchWorldTiles(pg::StdNumberGenerator &rngenerator, int tileRadius,
+                     uint32_t flags, const std::string &name)
+{
+    StripeGenerator generator;
+    pg::VoronoiMesh<float, TileType> mesh(rngenerator, generator, 8, 8, 120,
+                                          120);
+    mesh.GenerateRegion({{-tileRadius, -tileRadius}},
+                        {{tileRadius - 1, tileRadius - 1}});
+
+    pg::VoronoiWorldHeader header;
+    header.scalarSize = sizeof(float);
+    header.tileDensityX = mesh.TileDensityX();
+    header.tileDensityY = mesh.TileDensityY();
+    header.unitX = mesh.UnitX();
+    header.unitY = mesh.UnitY();
+    header.flags = flags;
+
+    size_t tileBytes = 0;
+    for(const auto &tile : mesh.Tiles())
+        tileBytes += tile.second.Sites().size()
+                   * (2 * sizeof(float) + sizeof(TileType));
+
+    std::ostringstream out(std::ios_base::out | std::ios_base::binary);
+    std::vector<size_t> ends;
+    double encodeTime = measureSeconds([&]
+    {
+        pg::OutputStream stream(out);
+        for(const auto &tile : mesh.Tiles())
+        {
+            pg::WriteWorldTile(stream, header, tile.first.coord, tile.second);
+            ends.push_back(stream.Written());
+        }
+    });
+    std::string data = out.str();
+    std::cout << name << ": " << data.size() / (1024. * 1024.)
+              << " MiB stored" << std::endl;
+    report(name + " encode", tileBytes, encodeTime);
+
+    pg::VoronoiTile<float, TileType> decoded;
+    bool good = true;
+    double decodeTime = measureSeconds([&]
+    {
+        size_t begin = 0;
+        size_t i = 0;
+        for(const auto &tile : mesh.Tiles())
+        {
+            good &= pg::ReadWorldTile(header, tile.first.coord,
+                                      data.data() + begin, ends[i] - begin,
+                                      decoded);
+            begin = ends[i++];
+        }
+    });
+    report(name + " decode", tileBytes, decodeTime);
+    if(!good)
+        std::cout << name << ": decoding failed" << std::endl;
+}
+
+void BenchBulk(size_t count)
+{
+    std::vector<float> values(count);
+    for(size_t i = 0; i < count; ++i)
+        values[i] = i * .5f;
+
+    std::ostringstream out(std::ios_base::out | std::ios_base::binary);
+    double saveTime = measureSeconds([&]
+    {
+        pg::OutputStream stream(out);
+        stream << values;
+    });
+    std::string data = out.str();
+    report("Save float array", data.size(), saveTime);
+
+    std::vector<float> loaded;
+    std::istringstream in(data, std::ios_base::in | std::ios_base::binary);
+    double loadTime = measureSeconds([&]
+    {
+        pg::InputStream stream(in);
+        stream >> loaded;
+    });
+    report("Load float array", data.size(), loadTime);
+}
+
+int main(int argc, char *argv[])
+{
+    pg::StdNumberGenerator rngenerator;
+    int tileRadius = argc > 1 ? std::atoi(argv[1]) : 64;
+
+    BenchMesh(rngenerator, tileRadius);
+    BenchWorldTiles(rngenerator, tileRadius, 0, "Raw tiles");
+    BenchWorldTiles(rngenerator, tileRadius,
+                    pg::VoronoiWorldHeader::FLAG_COMPRESSED,
+                    "Compressed tiles");
+    BenchBulk(1 << 24);
+
+    return EXIT_SUCCESS;
+}
+
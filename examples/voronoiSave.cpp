@@ -10,6 +10,7 @@
 #include "../random/StdNumberGenerator.hpp"
 #include "../random/Distribution.hpp"
 #include "../algorithm/VoronoiMesh.hpp"
+#include "../algorithm/VoronoiWorldFile.hpp"
 #include "../core/Map.hpp"
 
 struct Color : public pg::Serializable
@@ -109,12 +110,10 @@ void TestVoronoi(pg::StdNumberGenerator &rngenerator, bool in)
     
     if(in)
     {
-        map = new pg::VoronoiMesh<float, Color>(rngenerator, colorGenerator);
-        
-        std::ifstream s(DATA_FILENAME.c_str(),
-                        std::ios_base::in | std::ios_base::binary);
-        pg::InputStream stream(s);
-        stream >> *map;
+        // Tiles are only read from the file when drawMesh needs them
+        map = new pg::MappedVoronoiMesh<float, Color>(rngenerator,
+                                                      colorGenerator,
+                                                      DATA_FILENAME);
     }
     else
         map = new pg::VoronoiMesh<float, Color>(rngenerator, colorGenerator, 8,
@@ -126,12 +125,7 @@ void TestVoronoi(pg::StdNumberGenerator &rngenerator, bool in)
     drawMesh(texture, *map, WIDTH, HEIGHT);
 
     if(!in)
-    {
-        std::ofstream s(DATA_FILENAME.c_str(),
-                        std::ios_base::out | std::ios_base::binary);
-        pg::OutputStream stream(s);
-        stream << *map;
-    }
+        pg::SaveVoronoiWorld(*map, DATA_FILENAME);
 
     sf::Sprite sprite;
     sprite.setTexture(texture.getTexture());
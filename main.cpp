@@ -2,18 +2,20 @@
 #include <fstream>
 #include <random>
 #include <cstdlib>
+#include <cmath>
 #include <vector>
 #include <string>
 
 #include <SFML/Graphics.hpp>
 
-#include "random/StdNumberGenerator.hpp"
+#include "random/SeededNumberGenerator.hpp"
 #include "random/Distribution.hpp"
 #include "algorithm/VoronoiMesh.hpp"
 #include "core/Map.hpp"
 
 #include "TileType.h"
 #include "MeshSpriteGroup.h"
+#include "ChunkDiskCache.h"
 #include "IslandGenerator.h"
 
 struct Direction
@@ -22,31 +24,47 @@ struct Direction
     bool enabled;
 };
 
-int main()
+int main(int argc, char *argv[])
 {
-    pg::StdNumberGenerator rngenerator;
+    sf::Clock startupClock;
+
+    // The same seed gives the same world, whose chunks are cached on disk
+    unsigned int seed = argc > 1 ? std::stoul(argv[1])
+                                 : std::random_device()();
+    std::cout << "Seed " << seed << std::endl;
+    pg::SeededNumberGenerator rngenerator(seed);
 
     const unsigned int WIDTH = 640;
     const unsigned int HEIGHT = 640;
 
-    IslandGenerator islandGenerator(WIDTH, HEIGHT);
+    IslandGenerator islandGenerator(WIDTH, HEIGHT, seed);
     pg::VoronoiMesh<float, TileType> map(rngenerator,
                                          islandGenerator, 8, 8, 120, 120);
 
-    MeshSpriteGroup meshSpriteGroup(map, WIDTH, HEIGHT);
+    ChunkDiskCache diskCache("chunkCache", map, islandGenerator.ConfigHash(),
+                             WIDTH, HEIGHT);
+    MeshSpriteGroup meshSpriteGroup(map, WIDTH, HEIGHT, &diskCache);
     
     sf::RenderWindow window(sf::VideoMode(WIDTH, HEIGHT), "Voronoi");
     window.setFramerateLimit(60);
 
+    // Sampling step of the last frame, to report startup progress
+    size_t shownStep = 0;
+
     float x = 0;
     float y = 0;
+    float zoom = 1;
     const float MOVE_VELOCITY = 4;
+    const float ZOOM_VELOCITY = 1.02f;
+    const float WHEEL_ZOOM = 1.25f;
 
-    const size_t DIRECTION_COUNT = 4;
+    const size_t DIRECTION_COUNT = 6;
     Direction directions[DIRECTION_COUNT] = {{sf::Keyboard::Left, false},
                                              {sf::Keyboard::Right, false},
                                              {sf::Keyboard::Up, false},
-                                             {sf::Keyboard::Down, false}};
+                                             {sf::Keyboard::Down, false},
+                                             {sf::Keyboard::Add, false},
+                                             {sf::Keyboard::Subtract, false}};
 
     while(window.isOpen())
     {
@@ -64,6 +82,8 @@ int main()
                         break;
                     }
             }
+            else if(event.type == sf::Event::MouseWheelScrolled)
+                zoom *= std::pow(WHEEL_ZOOM, -event.mouseWheelScroll.delta);
             else if(event.type == sf::Event::KeyReleased)
             {
                 for(size_t i = 0; i < DIRECTION_COUNT; ++i)
@@ -76,20 +96,35 @@ int main()
         }
 
         if(directions[0].enabled)
-            x -= MOVE_VELOCITY;
+            x -= MOVE_VELOCITY * zoom;
         else if(directions[1].enabled)
-            x += MOVE_VELOCITY;
+            x += MOVE_VELOCITY * zoom;
         if(directions[2].enabled)
-            y -= MOVE_VELOCITY;
+            y -= MOVE_VELOCITY * zoom;
         else if(directions[3].enabled)
-            y += MOVE_VELOCITY;
-
+            y += MOVE_VELOCITY * zoom;
+        if(directions[4].enabled)
+            zoom /= ZOOM_VELOCITY;
+        else if(directions[5].enabled)
+            zoom *= ZOOM_VELOCITY;
+
+        meshSpriteGroup.SetZoom(zoom);
+        zoom = meshSpriteGroup.Zoom();
         meshSpriteGroup.setPosition(x, y);
         meshSpriteGroup.Refresh();
 
         window.clear();
         window.draw(meshSpriteGroup);
         window.display();
+
+        size_t step = meshSpriteGroup.Step();
+        if(step != 0 && (shownStep == 0 || step < shownStep))
+        {
+            std::cout << "1/" << step << " resolution after "
+                      << startupClock.getElapsedTime().asMilliseconds()
+                      << " ms" << std::endl;
+            shownStep = step;
+        }
     }
 
     return EXIT_SUCCESS;
@@ -6,10 +6,14 @@
 #include <cmath>
 
 #include "../random/RandomEngine.hpp"
+#include "../random/SeededNumberGenerator.hpp"
 #include "../core/Incrementable.hpp"
 
 namespace pg
 {
+    /* Gradients of the noise. Each one only depends on the seed drawn
+     * from the generator and on its coordinates, so the noise is the same
+     * whatever the order in which it is evaluated. */
     template<typename T, template<typename> class Dist, size_t DIM>
     class PerlinNodes : public pg::Incrementable<std::array<T, DIM>, DIM>
     {
@@ -17,9 +21,10 @@ namespace pg
             typedef std::array<T, DIM> Tuple;
 
             PerlinNodes(pg::NumberGenerator &generator,
-                        const Distribution<T, Dist> &distribution):
+                        const Distribution<T, Dist> &d):
                 pg::Incrementable<std::array<T, DIM>, DIM>(generator),
-                engine(generator, distribution)
+                distribution(d),
+                seed(generator())
             {
             }
 
@@ -31,26 +36,29 @@ namespace pg
                 auto it = this->tiles.find(coord);
                 if(it == this->tiles.end())
                 {
-                    Tuple vec = generateVector();
+                    unsigned int nodeSeed = CoordSeed(seed, coord);
+                    pg::SeededNumberGenerator generator(nodeSeed);
+                    pg::RandomEngine<T, Dist> engine(generator, distribution);
+                    Tuple vec = generateVector(engine);
                     return this->tiles.insert(std::make_pair(coord, vec)).first->second;
                 }
                 return it->second;
             }
             
             /* Generates a scalar in range [0, 1] */
-            inline T generateScalar()
+            static inline T generateScalar(pg::RandomEngine<T, Dist> &engine)
             {
                 return (engine() - engine.min())/(engine.max() - engine.min());
             }
 
-            Tuple generateVector()
+            static Tuple generateVector(pg::RandomEngine<T, Dist> &engine)
             {
                 Tuple ret;
                 T sum2 = 0;
                 for(size_t i = 0; i + 1 < DIM; ++i)
                 {
                     // Generate number in range [-1,1]
-                    ret[i] = 2 * generateScalar() - 1;
+                    ret[i] = 2 * generateScalar(engine) - 1;
                     sum2 += ret[i] * ret[i];
                 }
 
@@ -64,7 +72,7 @@ namespace pg
                         ret[DIM - 1] *= -1;
                 }
                 else
-                    ret[DIM - 1] = 2 * generateScalar() - 1;
+                    ret[DIM - 1] = 2 * generateScalar(engine) - 1;
                 sum2 += ret[DIM - 1] * ret[DIM - 1];
 
                 T length = std::sqrt(sum2); // Should be always strictly
@@ -75,7 +83,8 @@ namespace pg
                 return ret;
             }
 
-            pg::RandomEngine<T, Dist> engine;
+            pg::Distribution<T, Dist> distribution;
+            unsigned int seed;
     };
 
     template<typename T, template<typename> class Dist, size_t DIM>
@@ -95,21 +104,59 @@ namespace pg
 
             T operator()(const Tuple &tuple)
             {
-                std::array<uint8_t, DIM> base;
-                // No need to initialize the array since
-                // computeLocalContribution already does it
-                return (computeLocalContribution(tuple, base, 0) + 1) / 2.;
+                const Tuple *corners[1 << DIM];
+                for(size_t c = 0; c < (1 << DIM); ++c)
+                    corners[c] = &nodes.At(cornerCoord(tuple, c));
+                return evaluate(tuple, corners);
+            }
+
+            /* Evaluates the noise at tuple if the nodes around it were
+             * generated already, by operator() at a close enough tuple, and
+             * returns false otherwise. Only reads the noise, so it can run
+             * on several threads at once as long as operator() does not. */
+            bool TryEvaluate(const Tuple &tuple, T &value) const
+            {
+                const Tuple *corners[1 << DIM];
+                for(size_t c = 0; c < (1 << DIM); ++c)
+                {
+                    if(!nodes.HasTile(cornerCoord(tuple, c), corners[c]))
+                        return false;
+                }
+                value = evaluate(tuple, corners);
+                return true;
             }
 
         protected:
+            /* Node at corner c of the cell holding point, bit i of c
+             * selecting the upper bound along dimension i */
+            static std::array<int, DIM> cornerCoord(const Tuple &point,
+                                                    size_t c)
+            {
+                std::array<int, DIM> coord;
+                for(size_t i = 0; i < DIM; ++i)
+                    coord[i] = std::floor(point[i]) + ((c >> i) & 1);
+                return coord;
+            }
+
+            T evaluate(const Tuple &tuple,
+                       const Tuple *const (&corners)[1 << DIM]) const
+            {
+                // computeLocalContribution sets every element before
+                // reading it, but GCC cannot tell once inlined
+                std::array<uint8_t, DIM> base = {};
+                return (computeLocalContribution(tuple, base, 0, corners)
+                        + 1) / 2.;
+            }
+
             T contribution(const Tuple &point,
-                           const std::array<uint8_t, DIM> &relativeRef)
+                           const std::array<uint8_t, DIM> &relativeRef,
+                           const Tuple *const (&corners)[1 << DIM]) const
             {
-                std::array<int, DIM> absoluteRef;
+                size_t c = 0;
                 for(size_t i = 0; i < DIM; ++i)
-                    absoluteRef[i] = std::floor(point[i]) + relativeRef[i];
+                    c |= size_t(relativeRef[i]) << i;
 
-                const Tuple &tuple = nodes.At(absoluteRef);
+                const Tuple &tuple = *corners[c];
                 T product = 0;
                 for(size_t i = 0; i < DIM; ++i)
                 {
@@ -141,21 +188,26 @@ namespace pg
              * subtrees */
             T computeLocalContribution(const Tuple &point,
                                        const std::array<uint8_t, DIM> &base,
-                                       size_t dimIndex)
+                                       size_t dimIndex,
+                                       const Tuple *const (&corners)[1 << DIM])
+                const
             {
                 if(dimIndex == DIM) // Last dimension (leaf nodes)
-                    return contribution(point, base);
+                    return contribution(point, base, corners);
 
                 // Else, non-leaf nodes
                 std::array<uint8_t, DIM> tmp = base;
 
                 // Compute left subtree
                 tmp[dimIndex] = 0;
-                T leftResult = computeLocalContribution(point, tmp, dimIndex + 1);
+                T leftResult = computeLocalContribution(point, tmp,
+                                                        dimIndex + 1, corners);
 
                 // Compute right subtree
                 tmp[dimIndex] = 1;
-                T rightResult = computeLocalContribution(point, tmp, dimIndex + 1);
+                T rightResult = computeLocalContribution(point, tmp,
+                                                         dimIndex + 1,
+                                                         corners);
 
                 T factor = smooth(fractionalPart(point[dimIndex]));
 
@@ -0,0 +1,60 @@
+#ifndef SEEDED_NUMBER_GENERATOR_HPP
+#define SEEDED_NUMBER_GENERATOR_HPP
+
+#include <random>
+#include <array>
+#include <cstdint>
+
+#include "NumberGenerator.hpp"
+
+namespace pg
+{
+    /* Deterministic counterpart of StdNumberGenerator: the same seed always
+     * yields the same sequence */
+    class SeededNumberGenerator : public pg::NumberGenerator
+    {
+        public:
+            SeededNumberGenerator(result_type seed):
+                engine(seed)
+            {
+            }
+
+            virtual ~SeededNumberGenerator() = default;
+
+            virtual result_type operator()()
+            {
+                return engine();
+            }
+
+            virtual result_type min()
+            {
+                return engine.min();
+            }
+
+            virtual result_type max()
+            {
+                return engine.max();
+            }
+
+        protected:
+            std::mt19937 engine;
+    };
+
+    /* Seed of a cell of a grid, mixing the seed of the grid with the cell
+     * coordinates so that cells can be generated in any order */
+    template<size_t DIM>
+    unsigned int CoordSeed(unsigned int seed, const std::array<int, DIM> &coord)
+    {
+        // splitmix64 finalizer over the seed and the coordinates
+        const uint64_t GOLDEN = 0x9e3779b97f4a7c15ULL;
+        uint64_t h = seed;
+        for(size_t i = 0; i < DIM; ++i)
+            h = h * GOLDEN + static_cast<uint32_t>(coord[i]);
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        return static_cast<unsigned int>(h ^ (h >> 31));
+    }
+}
+
+#endif
+
@@ -0,0 +1,216 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../algorithm/VoronoiWorldFile.hpp"
+#include "../core/MappedFile.hpp"
+#include "../core/Serializable.hpp"
+
+struct MergeInput
+{
+    MergeInput(const std::string &name):
+        filename(name),
+        file(name)
+    {
+        header.Parse(file.Data(), file.Size());
+    }
+
+    pg::VoronoiWorldEntry Entry(uint64_t index) const
+    {
+        return pg::VoronoiWorldEntry::Load(file.Data()
+            + header.directoryOffset
+            + index * pg::VoronoiWorldHeader::ENTRY_SIZE);
+    }
+
+    std::string filename;
+    pg::MappedFile file;
+    pg::VoronoiWorldHeader header;
+};
+
+typedef std::vector<std::unique_ptr<MergeInput>> MergeInputs;
+
+/* Walks the directories of every input at once, in coordinate order, and
+ * calls f(input, entry) once per tile with the entry of the last input
+ * holding it. Only one entry per input is kept in memory. Returns the
+ * number of tiles hidden by a later input. */
+template<typename F>
+uint64_t ForEachMergedTile(const MergeInputs &inputs, F f)
+{
+    struct Cursor
+    {
+        pg::VoronoiWorldEntry entry;
+        size_t input;
+        uint64_t index;
+    };
+
+    // Lowest coordinates first, then latest input first
+    auto after = [](const Cursor &a, const Cursor &b)
+    {
+        if(a.entry < b.entry)
+            return false;
+        if(b.entry < a.entry)
+            return true;
+        return a.input < b.input;
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(after)>
+        heap(after);
+
+    auto advance = [&](Cursor cursor)
+    {
+        if(++cursor.index < inputs[cursor.input]->header.tileCount)
+        {
+            cursor.entry = inputs[cursor.input]->Entry(cursor.index);
+            heap.push(cursor);
+        }
+    };
+
+    for(size_t i = 0; i < inputs.size(); ++i)
+    {
+        if(inputs[i]->header.tileCount > 0)
+            heap.push({inputs[i]->Entry(0), i, 0});
+    }
+
+    uint64_t duplicates = 0;
+    while(!heap.empty())
+    {
+        Cursor top = heap.top();
+        heap.pop();
+        advance(top);
+
+        while(!heap.empty() && !(top.entry < heap.top().entry))
+        {
+            Cursor hidden = heap.top();
+            heap.pop();
+            advance(hidden);
+            ++duplicates;
+        }
+
+        f(*inputs[top.input], top.entry);
+    }
+    return duplicates;
+}
+
+/* Throws unless the input describes the same world as the first one and
+ * has a sorted directory pointing inside the file */
+void CheckInput(const MergeInput &input, const MergeInput &first)
+{
+    const pg::VoronoiWorldHeader &a = input.header;
+    const pg::VoronoiWorldHeader &b = first.header;
+    if(!a.SameWorld(b))
+        throw std::runtime_error(input.filename + " is not the same world as "
+                                 + first.filename);
+    if(a.flags != b.flags)
+        throw std::runtime_error(input.filename + " is not encoded as "
+                                 + first.filename);
+
+    for(uint64_t i = 0; i < a.tileCount; ++i)
+    {
+        pg::VoronoiWorldEntry entry = input.Entry(i);
+        if(entry.offset > input.file.Size()
+        || entry.length > input.file.Size() - entry.offset
+        || (i > 0 && !(input.Entry(i - 1) < entry)))
+            throw std::runtime_error("Corrupted world file "
+                                     + input.filename);
+    }
+}
+
+void Merge(const MergeInputs &inputs, const std::string &output)
+{
+    for(const auto &input : inputs)
+        CheckInput(*input, *inputs.front());
+
+    // First pass to size the output, so that it is written sequentially
+    uint64_t tileCount = 0;
+    uint64_t payloadSize = 0;
+    uint64_t duplicates = ForEachMergedTile(inputs,
+        [&](const MergeInput &, const pg::VoronoiWorldEntry &entry)
+        {
+            ++tileCount;
+            payloadSize += entry.length;
+        });
+
+    pg::VoronoiWorldHeader header = inputs.front()->header;
+    header.version = pg::VoronoiWorldHeader::VERSION;
+    header.tileCount = tileCount;
+    header.directoryOffset = pg::VoronoiWorldHeader::HEADER_SIZE
+                           + payloadSize;
+
+    std::string tmpName = output + ".tmp";
+    int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        throw std::runtime_error("Cannot open " + tmpName);
+
+    bool good;
+    {
+        pg::FileDescriptorSink sink(fd);
+        pg::OutputStream stream(sink);
+        header.Serialize(stream);
+
+        ForEachMergedTile(inputs,
+            [&](const MergeInput &input, const pg::VoronoiWorldEntry &entry)
+            {
+                stream.Write(input.file.Data() + entry.offset, entry.length);
+            });
+
+        uint64_t offset = pg::VoronoiWorldHeader::HEADER_SIZE;
+        ForEachMergedTile(inputs,
+            [&](const MergeInput &, const pg::VoronoiWorldEntry &entry)
+            {
+                pg::VoronoiWorldEntry merged = entry;
+                merged.offset = offset;
+                merged.Serialize(stream);
+                offset += entry.length;
+            });
+
+        stream.Flush();
+        good = stream.Good();
+    }
+    good &= fsync(fd) == 0;
+    good &= close(fd) == 0;
+
+    if(!good || std::rename(tmpName.c_str(), output.c_str()) != 0)
+    {
+        std::remove(tmpName.c_str());
+        throw std::runtime_error("Cannot write " + output);
+    }
+
+    std::cout << tileCount << " tiles, " << duplicates
+              << " duplicates resolved, "
+              << header.directoryOffset
+               + tileCount * pg::VoronoiWorldHeader::ENTRY_SIZE
+              << " bytes written" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 3)
+    {
+        std::cout << "Usage: ./worldMerge output input..." << std::endl
+                  << "Tiles present in several inputs are taken from the "
+                     "last one." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        MergeInputs inputs;
+        for(int i = 2; i < argc; ++i)
+            inputs.emplace_back(new MergeInput(argv[i]));
+        Merge(inputs, argv[1]);
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << "worldMerge: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
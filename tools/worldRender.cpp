@@ -0,0 +1,253 @@
+#include <iostream>
+#include <string>
+#include <memory>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <random>
+
+#include "../algorithm/Coastline.hpp"
+#include "../algorithm/DistanceField.hpp"
+#include "../algorithm/MeshRenderer.hpp"
+#include "../algorithm/SiteGraph.hpp"
+#include "../algorithm/VoronoiWorldFile.hpp"
+#include "../core/Image.hpp"
+#include "../core/MappedFile.hpp"
+#include "../core/ThreadPool.hpp"
+#include "../random/SeededNumberGenerator.hpp"
+#include "../noise/PerlinNoise2.hpp"
+
+#include "../TileType.h"
+#include "../TileColors.h"
+#include "../IslandGenerator.h"
+
+struct RenderOptions
+{
+    std::string output;
+    std::string world;
+    float x = 0;
+    float y = 0;
+    size_t width = 0;
+    size_t height = 0;
+    size_t posterWidth = 0;
+    size_t posterHeight = 0;
+    unsigned int seed = std::random_device()();
+    bool noise = false;
+    bool coastline = false;
+    bool shallow = false;
+    bool islands = false;
+};
+
+typedef pg::VoronoiMesh<float, TileType> Mesh;
+
+/* "name.png" split in 3x2 posters gives "name_2_1.png" for the bottom
+ * right one */
+std::string PosterName(const std::string &output, size_t column, size_t row)
+{
+    size_t dot = output.rfind('.');
+    return output.substr(0, dot) + "_" + std::to_string(column) + "_"
+         + std::to_string(row) + output.substr(dot);
+}
+
+/* Seed the world file was generated with, which its missing tiles and the
+ * island noise are generated from */
+unsigned int WorldSeed(const std::string &filename)
+{
+    pg::MappedFile file(filename);
+    pg::VoronoiWorldHeader header;
+    header.Parse(file.Data(), file.Size());
+    return header.seed;
+}
+
+void RenderNoise(const RenderOptions &options)
+{
+    const float NOISE_DETAIL = 1.f / 32.f;
+
+    pg::SeededNumberGenerator rngenerator(options.seed);
+    pg::PerlinNoiseUniformFloat<2> noise(rngenerator);
+
+    pg::Image image(options.width, options.height);
+    pg::RenderField(image, options.x, options.y,
+                    [&](float x, float y, uint8_t *rgba)
+    {
+        uint8_t value = noise({x * NOISE_DETAIL, y * NOISE_DETAIL}) * 255.f;
+        rgba[0] = value;
+        rgba[1] = value;
+        rgba[2] = value;
+        rgba[3] = 0xff;
+    });
+    pg::SaveImage(image, options.output);
+}
+
+void DrawCoastlines(Mesh &mesh, pg::Image &image,
+                    const RenderOptions &options)
+{
+    const uint8_t COLOR[4] = {0, 0, 0, 0xff};
+
+    pg::SeededNumberGenerator rngenerator(options.seed);
+    pg::CoastlineMesh<float, TileType> coastlines(rngenerator, mesh);
+    std::vector<pg::Polyline<float>> polylines;
+    coastlines.Coastlines(
+        {{int(std::floor(options.x / mesh.UnitX())),
+          int(std::floor(options.y / mesh.UnitY()))}},
+        {{int(std::floor((options.x + options.width) / mesh.UnitX())),
+          int(std::floor((options.y + options.height) / mesh.UnitY()))}},
+        polylines);
+
+    size_t segments = 0;
+    for(const auto &polyline : polylines)
+    {
+        pg::DrawPolyline(image, options.x, options.y, polyline, COLOR);
+        segments += polyline.size() - 1;
+    }
+    std::cout << polylines.size() << " coastlines, " << segments
+              << " segments" << std::endl;
+}
+
+void DrawShallows(Mesh &mesh, pg::Image &image,
+                  const RenderOptions &options, pg::ThreadPool &pool)
+{
+    const float DEPTH = 40;
+
+    pg::SeededNumberGenerator rngenerator(options.seed);
+    pg::DistanceFieldMesh<float, TileType> field(rngenerator, mesh, pool,
+                                                 DEPTH);
+    for(size_t y = 0; y < image.Height(); ++y)
+        for(size_t x = 0; x < image.Width(); ++x)
+        {
+            pg::VPoint<float> point(x + options.x, y + options.y);
+            ShallowColor(field.Distance(point), DEPTH, image.Pixel(x, y));
+        }
+}
+
+/* Islands are counted over the tiles overlapping the area */
+void CountIslands(Mesh &mesh, const RenderOptions &options)
+{
+    pg::IslandLabels<float, TileType> labels(mesh);
+    int minX = std::floor(options.x / mesh.UnitX());
+    int minY = std::floor(options.y / mesh.UnitY());
+    int maxX = std::floor((options.x + options.width) / mesh.UnitX());
+    int maxY = std::floor((options.y + options.height) / mesh.UnitY());
+    for(int y = minY; y <= maxY; ++y)
+        for(int x = minX; x <= maxX; ++x)
+            labels.AddTile({{x, y}});
+
+    size_t largest = labels.LargestIsland();
+    std::cout << labels.IslandCount() << " islands";
+    if(largest != labels.NONE)
+        std::cout << ", the largest has " << labels.IslandSize(largest)
+                  << " sites";
+    std::cout << std::endl;
+}
+
+void RenderWorld(const RenderOptions &options)
+{
+    const float UNIT = 120;
+
+    // Same world as main for the same seed, the world file's with --world
+    pg::SeededNumberGenerator rngenerator(options.seed);
+    IslandGenerator islandGenerator(640, 640, options.seed);
+    std::unique_ptr<Mesh> mesh;
+    if(options.world.empty())
+        mesh.reset(new Mesh(rngenerator, islandGenerator, 8, 8, UNIT, UNIT));
+    else
+        mesh.reset(new pg::MappedVoronoiMesh<float, TileType>(
+            rngenerator, islandGenerator, options.world));
+
+    if(options.islands)
+        CountIslands(*mesh, options);
+
+    pg::ThreadPool pool;
+    if(options.posterWidth == 0)
+    {
+        pg::Image image(options.width, options.height);
+        pg::RenderMesh(*mesh, image, options.x, options.y, TileColor, pool);
+        if(options.shallow)
+            DrawShallows(*mesh, image, options, pool);
+        if(options.coastline)
+            DrawCoastlines(*mesh, image, options);
+        pg::SaveImage(image, options.output);
+        return;
+    }
+
+    pg::RenderPoster(*mesh, options.x, options.y,
+                     options.width, options.height,
+                     options.posterWidth, options.posterHeight, TileColor,
+                     [&](size_t column, size_t row, const pg::Image &image)
+    {
+        pg::SaveImage(image, PosterName(options.output, column, row));
+    }, pool);
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 6)
+    {
+        std::cout << "Usage: ./worldRender output x y width height "
+                     "[--seed seed] [--world file] [--poster width height] "
+                     "[--noise] [--coastline] [--shallow] [--islands]"
+                  << std::endl
+                  << "The output format is chosen from its extension, "
+                     ".png or .ppm." << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    try
+    {
+        RenderOptions options;
+        options.output = argv[1];
+        options.x = std::stof(argv[2]);
+        options.y = std::stof(argv[3]);
+        options.width = std::stoul(argv[4]);
+        options.height = std::stoul(argv[5]);
+
+        for(int i = 6; i < argc; ++i)
+        {
+            std::string option = argv[i];
+            if(option == "--seed" && i + 1 < argc)
+                options.seed = std::stoul(argv[++i]);
+            else if(option == "--world" && i + 1 < argc)
+                options.world = argv[++i];
+            else if(option == "--poster" && i + 2 < argc)
+            {
+                options.posterWidth = std::stoul(argv[++i]);
+                options.posterHeight = std::stoul(argv[++i]);
+            }
+            else if(option == "--noise")
+                options.noise = true;
+            else if(option == "--coastline")
+                options.coastline = true;
+            else if(option == "--shallow")
+                options.shallow = true;
+            else if(option == "--islands")
+                options.islands = true;
+            else
+                throw std::invalid_argument("Unknown option " + option);
+        }
+
+        if((options.coastline || options.shallow)
+        && options.posterWidth != 0)
+        {
+            throw std::invalid_argument("--coastline and --shallow need a "
+                                        "single image");
+        }
+
+        // Random unless given or read from the world file, so printed to
+        // render the same world again
+        if(!options.world.empty())
+            options.seed = WorldSeed(options.world);
+        std::cout << "Seed " << options.seed << std::endl;
+
+        if(options.noise)
+            RenderNoise(options);
+        else
+            RenderWorld(options);
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << "worldRender: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}